@@ -30,16 +30,20 @@ void Camera::setViewMatrix(float mouseXposOffset, float mouseYposOffset) {
   float theta_rad = mat::toRads(theta);
   float phi_rad = mat::toRads(phi);
 
-  cameraFront(0) = cos(theta_rad) * sin(phi_rad);
-  cameraFront(1) = sin(theta_rad);
-  cameraFront(2) = -cos(theta_rad) * cos(phi_rad);
-  viewMatrix = mat::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+  float sinTheta, cosTheta, sinPhi, cosPhi;
+  mat::sincos(theta_rad, sinTheta, cosTheta);
+  mat::sincos(phi_rad, sinPhi, cosPhi);
+  cameraFront(0) = cosTheta * sinPhi;
+  cameraFront(1) = sinTheta;
+  cameraFront(2) = -cosTheta * cosPhi;
+  viewMatrix = mat::lookAt(Vec3f{}, cameraFront, cameraUp);
 }
 
 void Camera::setCameraPos(float dX, float dY, float dZ) {
-  cameraPos += dX * mat::cross(cameraFront, cameraUp);
-  cameraPos += dY * cameraUp;
-  cameraPos += dZ * cameraFront;
+  Vec3f delta = dX * mat::cross(cameraFront, cameraUp);
+  delta += dY * cameraUp;
+  delta += dZ * cameraFront;
+  cameraPos += delta.cast<double>();
 }
 
-const Vec3f &Camera::getCameraPos() const { return this->cameraPos; }
\ No newline at end of file
+const Vec3d &Camera::getCameraPos() const { return this->cameraPos; }
\ No newline at end of file
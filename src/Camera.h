@@ -10,15 +10,18 @@ private:
   Mat4f projectionMatrix;
   float fov;
 
+  // Camera relative view matrix: rotation only, the eye translation is
+  // applied in double precision subtracting getCameraPos from the world
+  // positions (see mat::relativePosition)
   Mat4f viewMatrix;
   float phi = 0;
   float theta = 0;
   Vec3f cameraUp{0.0f, 1.0f, 0.0f};
-  Vec3f cameraPos;
+  Vec3d cameraPos;
   Vec3f cameraFront{0.0f, 0.0f, -1.0f};
 
 public:
-  Camera(float fov, Vec3f position = Vec3f{})
+  Camera(float fov, Vec3d position = Vec3d{})
       : viewMatrix{mat::identity()}, projectionMatrix{mat::identity()},
         fov{fov}, cameraPos{std::move(position)} {};
   const Mat4f &getProjectionMatrix() const;
@@ -27,7 +30,7 @@ public:
   void setOrthographicMatrix(float r, float t);
   void setViewMatrix(float mouseXposOffset, float mouseYposOffset);
   void setCameraPos(float dX, float dY, float dZ);
-  const Vec3f &getCameraPos() const;
+  const Vec3d &getCameraPos() const;
 };
 
 #endif // CAMERA_C
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "WindowManager.h"
 
+#include "buffer/GLState.h"
+
 #include <stdexcept>
 
 static void framebuffer_size_callback(GLFWwindow *window, int width,
@@ -67,10 +69,10 @@ WindowManager::WindowManager(float screenWidth, float screenHeight)
   glfwSetScrollCallback(window, scroll_callback);
   glfwSetCursorPosCallback(window, mouse_callback);
   // gamma correction is done in the post processing stage
-  glDisable(GL_FRAMEBUFFER_SRGB);
+  GLState::get().disable(GL_FRAMEBUFFER_SRGB);
   // Enable blending
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GLState::get().enable(GL_BLEND);
+  GLState::get().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 bool WindowManager::created{false};
@@ -0,0 +1,872 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../ecs/World.h"
+#include "../jobs/JobSystem.h"
+#include "../math/AlignedAllocator.h"
+#include "../math/Frustum.h"
+#include "../math/Matrix.h"
+#include "../math/MatrixSimd.h"
+#include "../math/MatrixUtils.h"
+#include "../math/Quaternion.h"
+#include "../math/TransformBatch.h"
+#include "../math/Trig.h"
+#include "../objects/Components.h"
+#include "../objects/Light.h"
+#include "../objects/LightClusters.h"
+#include "../objects/LightGrid.h"
+#include "../objects/RenderQueue.h"
+#include "../objects/TransparentQueue.h"
+
+// Microbenchmarks of the math library, it doesn't need a GL context.
+// Every kernel runs on batches of different sizes, small batches are
+// repeated until a sample lasts at least MIN_SAMPLE_TIME. Each measure is
+// made of REPETITIONS samples, the report shows their mean and standard
+// deviation in ns per operation, plus the resulting throughput.
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t BATCH_SIZES[] = {1, 16, 256, 4096};
+constexpr std::size_t MAX_BATCH = 4096;
+constexpr int REPETITIONS = 15;
+constexpr std::chrono::nanoseconds MIN_SAMPLE_TIME{1'000'000};
+
+// Keeps the compiler from optimizing away the results of a kernel
+template <typename T> void doNotOptimize(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Stats {
+  double mean;
+  double stddev;
+  double min;
+};
+
+Stats computeStats(const std::vector<double> &samples) {
+  const double n = samples.size();
+  double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+  double var = 0.0;
+  for (double s : samples) {
+    var += (s - mean) * (s - mean);
+  }
+  var /= n > 1 ? n - 1 : 1;
+  return {mean, std::sqrt(var),
+          *std::min_element(samples.begin(), samples.end())};
+}
+
+/**
+ * Measure a kernel
+ * @param name - printed name of the kernel
+ * @param batch - number of operations done by a call of fn
+ * @param fn - callable that runs the kernel on the whole batch
+ */
+template <typename Fn>
+Stats measure(std::string_view name, std::size_t batch, Fn &&fn) {
+  // Calibration: calls per sample
+  std::size_t calls = 1;
+  while (true) {
+    auto start = Clock::now();
+    for (std::size_t c = 0; c < calls; c++) {
+      fn();
+    }
+    if (Clock::now() - start >= MIN_SAMPLE_TIME)
+      break;
+    calls *= 2;
+  }
+  std::vector<double> samples;
+  for (int r = 0; r < REPETITIONS; r++) {
+    auto start = Clock::now();
+    for (std::size_t c = 0; c < calls; c++) {
+      fn();
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    samples.push_back(elapsed.count() / (calls * batch));
+  }
+  Stats stats = computeStats(samples);
+  std::printf("%-34.*s %6zu %10.2f %9.2f %9.2f %10.1f\n",
+              static_cast<int>(name.size()), name.data(), batch, stats.mean,
+              stats.stddev, stats.min, 1e3 / stats.mean);
+  return stats;
+}
+
+void printHeader(std::string_view title) {
+  std::printf("\n== %.*s\n", static_cast<int>(title.size()), title.data());
+  std::printf("%-34s %6s %10s %9s %9s %10s\n", "kernel", "batch", "ns/op",
+              "stddev", "min", "Mop/s");
+}
+
+// Random inputs shared by all the benchmarks
+struct Inputs {
+  AlignedVector<Mat4f, 16> a, b, affine, out;
+  AlignedVector<Vec4f, 16> v, outV;
+  std::vector<Vec3f> positions, axes;
+  std::vector<Quatf> quats, outQ;
+  std::vector<float> angles, scales;
+  std::vector<Mat3f> outN;
+
+  explicit Inputs(std::size_t n)
+      : a(n), b(n), affine(n), out(n), v(n), outV(n), outQ(n), outN(n) {
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> posDist(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> scaleDist(0.1f, 4.0f);
+    for (std::size_t i = 0; i < n; i++) {
+      for (std::size_t k = 0; k < 16; k++) {
+        a[i].data()[k] = dist(gen);
+        b[i].data()[k] = dist(gen);
+      }
+      for (std::size_t k = 0; k < 4; k++) {
+        v[i].data()[k] = dist(gen);
+      }
+      positions.push_back(Vec3f{posDist(gen), posDist(gen), posDist(gen)});
+      axes.push_back(
+          mat::normalize(Vec3f{dist(gen), dist(gen), dist(gen) + 2.0f}));
+      angles.push_back(dist(gen) * 3.14f);
+      scales.push_back(scaleDist(gen));
+      quats.push_back(Quatf::fromAxisAngle(angles[i], axes[i]));
+      // Non uniform, like the entities stretched along an axis
+      Vec4f s{scales[i], 0.5f * scales[i], 2.0f * scales[i], 1.0f};
+      affine[i] = mat::modelMatrix(positions[i], s, quats[i]);
+    }
+  }
+};
+
+void benchMatrix(Inputs &in) {
+  printHeader("Matrix");
+  for (std::size_t n : BATCH_SIZES) {
+    measure("Mat4f * Mat4f", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = in.a[i] * in.b[i];
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("Mat4f * Vec4f", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.outV[i] = in.a[i] * in.v[i];
+      }
+      doNotOptimize(in.outV);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("Mat4f + Mat4f * float", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = in.a[i] + in.b[i] * 2.0f;
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::inverse", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = mat::inverse(in.affine[i]);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::affineInverse", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = mat::affineInverse(in.affine[i]);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::normalMatrix", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.outN[i] = mat::normalMatrix(in.affine[i]);
+      }
+      doNotOptimize(in.outN);
+    });
+  }
+}
+
+void benchTransforms(Inputs &in) {
+  printHeader("Transforms");
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::rotate", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = mat::rotate(in.angles[i], in.axes[i]);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  const Vec3f target{0.0f, 0.0f, 0.0f};
+  const Vec3f up{0.0f, 1.0f, 0.0f};
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::lookAt", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = mat::lookAt(in.positions[i], target, up);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::perspectiveProjection", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = mat::perspectiveProjection(in.scales[i], 1.33f, 0.1f,
+                                               100.0f);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::modelMatrix", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        Vec4f s{in.scales[i], in.scales[i], in.scales[i], 1.0f};
+        in.out[i] = mat::modelMatrix(in.positions[i], s, in.quats[i]);
+      }
+      doNotOptimize(in.out);
+    });
+  }
+  TransformBatch batch;
+  for (std::size_t n : BATCH_SIZES) {
+    batch.clear();
+    for (std::size_t i = 0; i < n; i++) {
+      batch.push_back(in.positions[i], in.scales[i], in.quats[i]);
+    }
+    measure("TransformBatch::computeModel..", n, [&] {
+      batch.computeModelMatrices(in.out);
+      doNotOptimize(in.out);
+    });
+  }
+}
+
+void benchQuaternions(Inputs &in) {
+  printHeader("Quaternions");
+  for (std::size_t n : BATCH_SIZES) {
+    measure("Quatf * Quatf", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.outQ[i] = in.quats[i] * in.quats[n - 1 - i];
+      }
+      doNotOptimize(in.outQ);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("mat::slerp", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.outQ[i] = mat::slerp(in.quats[i], in.quats[n - 1 - i], 0.3f);
+      }
+      doNotOptimize(in.outQ);
+    });
+  }
+  for (std::size_t n : BATCH_SIZES) {
+    measure("Quatf::toMat4", n, [&] {
+      for (std::size_t i = 0; i < n; i++) {
+        in.out[i] = in.quats[i].toMat4();
+      }
+      doNotOptimize(in.out);
+    });
+  }
+}
+
+// Batches of 16k angles in [-8pi, 8pi], the polynomial range. The max
+// absolute error against the double precision libm is printed first.
+void benchTrig() {
+  constexpr std::size_t N_ANGLES = 16384;
+  constexpr std::size_t TABLE_STEPS = 4096;
+  static constexpr mat::SinCosTable<TABLE_STEPS> table;
+  std::mt19937 gen{7};
+  std::uniform_real_distribution<float> dist(-8.0f * M_PI, 8.0f * M_PI);
+  std::vector<float> x(N_ANGLES), s(N_ANGLES), c(N_ANGLES);
+  std::vector<std::size_t> steps(N_ANGLES);
+  for (std::size_t i = 0; i < N_ANGLES; i++) {
+    x[i] = dist(gen);
+    steps[i] = gen() % TABLE_STEPS;
+  }
+
+  double maxError = 0.0;
+  mat::sincos(x, s, c);
+  for (std::size_t i = 0; i < N_ANGLES; i++) {
+    maxError = std::max(maxError, std::abs(s[i] - std::sin(double(x[i]))));
+    maxError = std::max(maxError, std::abs(c[i] - std::cos(double(x[i]))));
+  }
+  std::printf("\n== Trigonometry\nmat::sincos max absolute error %.3g\n",
+              maxError);
+  std::printf("%-34s %6s %10s %9s %9s %10s\n", "kernel", "batch", "ns/op",
+              "stddev", "min", "Mop/s");
+
+  measure("std::sin + std::cos", N_ANGLES, [&] {
+    for (std::size_t i = 0; i < N_ANGLES; i++) {
+      s[i] = std::sin(x[i]);
+      c[i] = std::cos(x[i]);
+    }
+    doNotOptimize(s);
+    doNotOptimize(c);
+  });
+  measure("mat::sincos scalar", N_ANGLES, [&] {
+    for (std::size_t i = 0; i < N_ANGLES; i++) {
+      mat::sincos(x[i], s[i], c[i]);
+    }
+    doNotOptimize(s);
+    doNotOptimize(c);
+  });
+  for (simd::ISA isa : {simd::ISA::SCALAR, simd::ISA::SSE4, simd::ISA::AVX2}) {
+    if (!simd::isSupported(isa))
+      continue;
+    const simd::MatrixKernels &k = simd::kernels(isa);
+    measure(std::string("sincos kernel ") + std::string(simd::isaName(isa)),
+            N_ANGLES, [&] {
+              k.sincos(x.data(), N_ANGLES, s.data(), c.data());
+              doNotOptimize(s);
+              doNotOptimize(c);
+            });
+  }
+  measure("mat::SinCosTable lookup", N_ANGLES, [&] {
+    for (std::size_t i = 0; i < N_ANGLES; i++) {
+      s[i] = table.sin(steps[i]);
+      c[i] = table.cos(steps[i]);
+    }
+    doNotOptimize(s);
+    doNotOptimize(c);
+  });
+}
+
+// Velocity integration of EntityManager::update over the archetype columns,
+// against the same data in heap objects visited through shuffled pointers
+// (the old layout of EntityManager)
+void benchEntityStorage() {
+  printHeader("Entity storage");
+  struct HeapEntity {
+    Transform transform;
+    Velocity velocity;
+  };
+  auto update = [](Transform &transform, const Velocity &velocity) {
+    integrate(transform, velocity, 0.016f);
+  };
+  std::mt19937 gen{3};
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (std::size_t n : {std::size_t{1'000}, std::size_t{64'000},
+                        std::size_t{1'000'000}}) {
+    ecs::World world;
+    std::vector<std::unique_ptr<HeapEntity>> heap;
+    for (std::size_t i = 0; i < n; i++) {
+      Velocity velocity{Vec3f{dist(gen), dist(gen), dist(gen)},
+                        Vec3f{dist(gen), dist(gen), dist(gen)}};
+      heap.push_back(std::make_unique<HeapEntity>(
+          HeapEntity{Transform(), Velocity{velocity.linear.clone(),
+                                           velocity.angular.clone()}}));
+      world.create(Transform(), std::move(velocity));
+    }
+    std::shuffle(heap.begin(), heap.end(), gen);
+    measure("update, pointers to heap", n, [&] {
+      for (auto &entity : heap) {
+        update(entity->transform, entity->velocity);
+      }
+      doNotOptimize(heap);
+    });
+    measure("update, ecs::World query", n, [&] {
+      world.query<Transform, const Velocity>().each(update);
+      doNotOptimize(world);
+    });
+  }
+}
+
+// EntityManager::update split in chunks on the job system, from 1 thread
+// to all the hardware threads. The speedup is relative to 1 thread. The
+// transforms must not depend on the number of threads, the ones updated on
+// 1 thread and on many are compared first
+void benchJobSystem() {
+  printHeader("Job system, parallel update");
+  constexpr std::size_t N_ENTITIES = 1'000'000;
+  constexpr std::size_t CHUNK = 1024;
+  constexpr int CHECK_FRAMES = 3;
+  auto createEntities = [](ecs::World &world) {
+    std::mt19937 gen{5};
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (std::size_t i = 0; i < N_ENTITIES; i++) {
+      world.create(Transform(),
+                   Velocity{Vec3f{dist(gen), dist(gen), dist(gen)},
+                            Vec3f{dist(gen), dist(gen), dist(gen)}});
+    }
+  };
+  auto update = [](ecs::World &world, JobSystem &jobs) {
+    world.query<Transform, const Velocity>().eachArchetype(
+        [&](std::span<const ecs::EntityId>, std::span<Transform> transforms,
+            std::span<const Velocity> velocities) {
+          jobs.parallelFor(transforms.size(), CHUNK,
+                           [&](std::size_t begin, std::size_t end) {
+                             for (std::size_t i = begin; i < end; i++) {
+                               integrate(transforms[i], velocities[i],
+                                         0.016f);
+                             }
+                           });
+        });
+  };
+  std::vector<std::size_t> threadCounts;
+  const std::size_t maxThreads =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  for (std::size_t t = 1; t < maxThreads; t *= 2) {
+    threadCounts.push_back(t);
+  }
+  threadCounts.push_back(maxThreads);
+
+  {
+    // Same frames on 1 thread and on all of them, bit for bit. At least 4
+    // threads, so that chunks are stolen even on small machines
+    const std::size_t checkThreads = std::max<std::size_t>(maxThreads, 4);
+    ecs::World single, parallel;
+    createEntities(single);
+    createEntities(parallel);
+    JobSystem oneThread{1};
+    JobSystem allThreads{checkThreads};
+    for (int frame = 0; frame < CHECK_FRAMES; frame++) {
+      update(single, oneThread);
+      update(parallel, allThreads);
+    }
+    std::vector<const Transform *> expected, actual;
+    single.query<const Transform>().each(
+        [&](const Transform &transform) { expected.push_back(&transform); });
+    parallel.query<const Transform>().each(
+        [&](const Transform &transform) { actual.push_back(&transform); });
+    std::size_t differing = 0;
+    for (std::size_t i = 0; i < expected.size(); i++) {
+      const Quatf &q0 = expected[i]->getRotation();
+      const Quatf &q1 = actual[i]->getRotation();
+      differing += std::memcmp(expected[i]->getPosition().data().data(),
+                               actual[i]->getPosition().data().data(),
+                               3 * sizeof(double)) != 0 ||
+                   std::memcmp(&q0, &q1, sizeof(Quatf)) != 0;
+    }
+    std::printf("%zu threads: %zu of %zu transforms differ from 1 thread\n",
+                checkThreads, differing, expected.size());
+  }
+
+  ecs::World world;
+  createEntities(world);
+  std::vector<double> means;
+  for (std::size_t t : threadCounts) {
+    JobSystem jobs{t};
+    Stats stats =
+        measure("update, " + std::to_string(t) + " threads", N_ENTITIES, [&] {
+          update(world, jobs);
+          doNotOptimize(world);
+        });
+    means.push_back(stats.mean);
+  }
+  std::printf("speedup:");
+  for (std::size_t k = 0; k < threadCounts.size(); k++) {
+    std::printf(" %zu -> %.2fx", threadCounts[k], means[0] / means[k]);
+  }
+  std::printf("\n");
+}
+
+// Lights reaching each entity: distance test against all the lights, as in
+// the old EntityManager::renderEntity, against the light grid. Then the
+// cost of moving the lights in the grid
+void benchLightGrid() {
+  printHeader("Light assignment");
+  constexpr std::size_t N_ENTITIES = 4096;
+  constexpr double WORLD_SIZE = 400.0;
+  std::mt19937 gen{9};
+  std::uniform_real_distribution<double> posDist(0.0, WORLD_SIZE);
+  auto randomPosition = [&] {
+    return Vec3d{posDist(gen), posDist(gen), posDist(gen)};
+  };
+  std::vector<Vec3d> entities;
+  for (std::size_t i = 0; i < N_ENTITIES; i++) {
+    entities.push_back(randomPosition());
+  }
+  const float radius = PointLight{Vec3f{1.0f, 1.0f, 1.0f}}.getRadius();
+  for (std::size_t nLights : {std::size_t{10}, std::size_t{100},
+                              std::size_t{1000}}) {
+    std::vector<Vec3d> lights;
+    LightGrid grid{16.0};
+    for (std::size_t l = 0; l < nLights; l++) {
+      lights.push_back(randomPosition());
+      grid.set(l, lights[l], radius);
+    }
+    const std::string suffix = ", " + std::to_string(nLights) + " lights";
+    measure("all lights" + suffix, N_ENTITIES, [&] {
+      std::size_t found = 0;
+      for (const Vec3d &entity : entities) {
+        for (const Vec3d &light : lights) {
+          const double r = 1.0 + radius;
+          found += mat::distance2(entity, light) < r * r;
+        }
+      }
+      doNotOptimize(found);
+    });
+    measure("LightGrid::query" + suffix, N_ENTITIES, [&] {
+      std::size_t found = 0;
+      for (const Vec3d &entity : entities) {
+        found += grid.query(entity, 1.0f).size();
+      }
+      doNotOptimize(found);
+    });
+    // Lights moving 0.1 per frame change cells once every ~100 frames
+    double offset = 0.0;
+    measure("LightGrid::set, moving" + suffix, nLights, [&] {
+      offset += 0.1;
+      for (std::size_t l = 0; l < nLights; l++) {
+        grid.set(l, lights[l] + Vec3d{offset, 0.0, 0.0}, radius);
+      }
+      doNotOptimize(grid);
+    });
+  }
+}
+
+// Binning of the lights in the view frustum clusters, once per frame
+void benchLightClusters() {
+  printHeader("Light clustering");
+  std::mt19937 gen{11};
+  std::uniform_real_distribution<float> posDist(-100.0f, 100.0f);
+  const float radius = PointLight{Vec3f{1.0f, 1.0f, 1.0f}}.getRadius();
+  const float near = 0.1f;
+  const float far = 100.0f;
+  const Mat4f projection =
+      mat::perspectiveProjection(mat::toRads(45.0f), 1.33f, near, far);
+  LightClusters clusters;
+  clusters.setProjection(projection);
+  const Mat4f view = mat::lookAt(Vec3f{}, Vec3f{0.3f, -0.4f, -0.8f},
+                                 Vec3f{0.0f, 1.0f, 0.0f});
+
+  // Points of the frustum in view space, and in the camera relative world
+  // space of the lights through the transposed rotation
+  constexpr std::size_t N_POINTS = 4096;
+  std::uniform_real_distribution<float> ndcDist(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> depthDist(near, far);
+  std::vector<Vec3f> viewPoints(N_POINTS);
+  std::vector<Vec3f> worldPoints(N_POINTS);
+  for (std::size_t p = 0; p < N_POINTS; p++) {
+    const float depth = depthDist(gen);
+    for (int a = 0; a < 2; a++) {
+      viewPoints[p](a) =
+          (ndcDist(gen) + projection(a, 2)) * depth / projection(a, a);
+    }
+    viewPoints[p](2) = -depth;
+    for (int i = 0; i < 3; i++) {
+      worldPoints[p](i) = view(0, i) * viewPoints[p](0) +
+                          view(1, i) * viewPoints[p](1) +
+                          view(2, i) * viewPoints[p](2);
+    }
+  }
+
+  for (std::size_t nLights : {std::size_t{100}, std::size_t{1000},
+                              std::size_t{10000}}) {
+    std::vector<Vec4f> lights;
+    for (std::size_t l = 0; l < nLights; l++) {
+      lights.push_back(
+          Vec4f{posDist(gen), posDist(gen), posDist(gen), radius});
+    }
+
+    // Every light containing a point must be in the cluster of the point
+    clusters.build(view, lights);
+    const auto ranges = clusters.getClusterRanges();
+    const auto indices = clusters.getLightIndices();
+    std::size_t pairs = 0;
+    std::size_t misses = 0;
+    for (std::size_t p = 0; p < N_POINTS; p++) {
+      const std::uint32_t cluster = clusters.clusterOf(viewPoints[p]);
+      const auto first = indices.begin() + ranges[2 * cluster];
+      const auto last = first + ranges[2 * cluster + 1];
+      for (std::uint32_t l = 0; l < nLights; l++) {
+        const Vec3f center{lights[l](0), lights[l](1), lights[l](2)};
+        if (mat::distance2(worldPoints[p], center) > radius * radius)
+          continue;
+        pairs++;
+        if (!std::binary_search(first, last, l)) {
+          misses++;
+        }
+      }
+    }
+    std::printf("LightClusters %zu lights: %zu misses in %zu light/point "
+                "pairs\n",
+                nLights, misses, pairs);
+
+    measure("LightClusters::build", nLights, [&] {
+      clusters.build(view, lights);
+      doNotOptimize(clusters);
+    });
+  }
+}
+
+// Back to front order of the transparent entities, once per frame: the
+// std::map the renderer used before, the radix sort of random distances
+// and the coherent case of a slowly moving camera
+void benchTransparentQueue() {
+  printHeader("Transparent sorting");
+  std::mt19937 gen{13};
+  std::uniform_real_distribution<float> posDist(-100.0f, 100.0f);
+  TransparentQueue queue;
+  for (std::size_t n : {std::size_t{256}, std::size_t{4096},
+                        std::size_t{32768}}) {
+    std::vector<Vec3f> positions;
+    for (std::size_t i = 0; i < n; i++) {
+      positions.push_back(Vec3f{posDist(gen), posDist(gen), posDist(gen)});
+    }
+    std::vector<float> distances(n);
+    auto computeDistances = [&](const Vec3f &camera) {
+      for (std::size_t i = 0; i < n; i++) {
+        distances[i] = mat::distance2(positions[i], camera);
+      }
+    };
+    computeDistances(Vec3f{});
+    measure("std::map", n, [&] {
+      std::map<double, std::uint32_t> sorted;
+      for (std::uint32_t i = 0; i < n; i++) {
+        sorted.insert(std::pair(distances[i], i));
+      }
+      doNotOptimize(sorted);
+    });
+    std::uint32_t frame = 0;
+    measure("TransparentQueue random", n, [&] {
+      // A different permutation of the distances every frame
+      frame++;
+      queue.clear();
+      for (std::uint32_t i = 0; i < n; i++) {
+        queue.push(i, distances[(i * 2654435761u + frame) % n]);
+      }
+      doNotOptimize(queue.sort());
+    });
+    float cameraX = 0.0f;
+    measure("TransparentQueue coherent", n, [&] {
+      cameraX += 0.01f;
+      computeDistances(Vec3f{cameraX, 0.0f, 0.0f});
+      queue.clear();
+      for (std::uint32_t i = 0; i < n; i++) {
+        queue.push(i, distances[i]);
+      }
+      doNotOptimize(queue.sort());
+    });
+  }
+}
+
+void benchRenderQueue() {
+  printHeader("Render queue");
+  std::mt19937 gen{17};
+  std::uniform_real_distribution<float> depthDist(0.0f, 10000.0f);
+  // Entities of 32 models with 2 materials of 4 meshes each
+  std::uniform_int_distribution<std::uint32_t> modelDist(0, 31);
+  RenderQueue queue;
+  for (std::size_t n : {std::size_t{256}, std::size_t{4096},
+                        std::size_t{32768}}) {
+    std::vector<std::uint32_t> models(n);
+    std::vector<float> depths(n);
+    for (std::size_t i = 0; i < n; i++) {
+      models[i] = modelDist(gen);
+      depths[i] = depthDist(gen);
+    }
+    measure("RenderQueue", n * 8, [&] {
+      queue.clear();
+      for (std::uint32_t i = 0; i < n; i++) {
+        for (std::uint32_t mesh = 0; mesh < 8; mesh++) {
+          queue.push(i % 2, 0, models[i] * 2 + mesh / 4, models[i] * 8 + mesh,
+                     depths[i], i);
+        }
+      }
+      doNotOptimize(queue.sort());
+    });
+    const RenderQueue::Stats &stats = queue.getStats();
+    std::printf("  %zu draws, %zu binds, %zu avoided\n", stats.draws,
+                stats.binds, stats.bindsAvoided);
+  }
+}
+
+// Counts the results of the kernels of an ISA that aren't bit-identical to
+// the code they stand in for, on the random inputs of the bench: the generic
+// Matrix products and the compile time loop of mat::multByDiagonal,
+// mat::modelMatrix (through the products checked first),
+// Frustum::intersectsSphere and simd::reference for the inverses and sincos
+void checkKernels(const simd::MatrixKernels &k, Inputs &in,
+                  const simd::TransformSoA &transforms,
+                  const simd::SphereSoA &spheres, const Frustum &frustum) {
+  auto differ = [](const float *expected, const float *actual,
+                   std::size_t n) {
+    return std::memcmp(expected, actual, n * sizeof(float)) != 0;
+  };
+  auto report = [](const char *kernel, std::size_t differing,
+                   std::size_t n) {
+    std::printf("%-20s %zu of %zu results differ from the reference\n",
+                kernel, differing, n);
+  };
+
+  std::size_t mul = 0, mulVec = 0, byDiagonal = 0, inverse = 0,
+              affineInverse = 0;
+  float expected[16], actual[16];
+  for (std::size_t i = 0; i < MAX_BATCH; i++) {
+    const float *a = in.a[i].data().data();
+    const float *b = in.b[i].data().data();
+    const float *v = in.v[i].data().data();
+    const float *affine = in.affine[i].data().data();
+    // Generic templates, not the overloads dispatched to the kernels
+    const Mat4f product = operator*<float, 4, 4, 4>(in.a[i], in.b[i]);
+    k.mat4Mul(a, b, actual);
+    mul += differ(product.data().data(), actual, 16);
+    const Matrix<float, 4, 1> productVec =
+        operator*<float, 4, 4, 1>(in.a[i], in.v[i]);
+    k.mat4MulVec(a, v, actual);
+    mulVec += differ(productVec.data().data(), actual, 4);
+    std::copy_n(a, 16, expected);
+    std::copy_n(a, 16, actual);
+    simd::reference::mat4MultByDiagonal(expected, v);
+    k.mat4MultByDiagonal(actual, v);
+    byDiagonal += differ(expected, actual, 16);
+    simd::reference::mat4Inverse(affine, expected);
+    k.mat4Inverse(affine, actual);
+    inverse += differ(expected, actual, 16);
+    simd::reference::mat4AffineInverse(affine, expected);
+    k.mat4AffineInverse(affine, actual);
+    affineInverse += differ(expected, actual, 16);
+  }
+  report("mat4Mul", mul, MAX_BATCH);
+  report("mat4MulVec", mulVec, MAX_BATCH);
+  report("mat4MultByDiagonal", byDiagonal, MAX_BATCH);
+  report("mat4Inverse", inverse, MAX_BATCH);
+  report("mat4AffineInverse", affineInverse, MAX_BATCH);
+
+  std::vector<float> matrices(16 * transforms.n);
+  k.buildModelMatrices(transforms, matrices.data());
+  std::size_t models = 0;
+  for (std::size_t i = 0; i < transforms.n; i++) {
+    const float s = transforms.scale[i];
+    const Mat4f model = mat::modelMatrix(
+        Vec3f{transforms.px[i], transforms.py[i], transforms.pz[i]},
+        Vec4f{s, s, s, 1.0f},
+        Quatf{transforms.qw[i], transforms.qx[i], transforms.qy[i],
+              transforms.qz[i]});
+    models += differ(model.data().data(), &matrices[16 * i], 16);
+  }
+  report("buildModelMatrices", models, transforms.n);
+
+  // Compared as visibility flags, a missing index and an extra one are
+  // two results
+  std::vector<std::uint32_t> visible(spheres.n);
+  std::vector<bool> actualVisible(spheres.n);
+  const std::size_t count =
+      k.cullSpheres(frustum.getPlanes().data(), spheres, visible.data());
+  for (std::size_t i = 0; i < count; i++) {
+    actualVisible[visible[i]] = true;
+  }
+  std::size_t culled = 0;
+  for (std::size_t i = 0; i < spheres.n; i++) {
+    culled += frustum.intersectsSphere(
+                  Vec3f{spheres.cx[i], spheres.cy[i], spheres.cz[i]},
+                  spheres.radius[i]) != actualVisible[i];
+  }
+  report("cullSpheres", culled, spheres.n);
+
+  // Up to +-8pi, all the quadrants
+  std::vector<float> x(MAX_BATCH), s(MAX_BATCH), c(MAX_BATCH);
+  for (std::size_t i = 0; i < MAX_BATCH; i++) {
+    x[i] = 8.0f * in.angles[i];
+  }
+  k.sincos(x.data(), MAX_BATCH, s.data(), c.data());
+  std::size_t sincos = 0;
+  for (std::size_t i = 0; i < MAX_BATCH; i++) {
+    float expectedSin, expectedCos;
+    simd::reference::sincos(x[i], expectedSin, expectedCos);
+    sincos += differ(&expectedSin, &s[i], 1) || differ(&expectedCos, &c[i], 1);
+  }
+  report("sincos", sincos, MAX_BATCH);
+}
+
+// Raw kernels of every instruction set supported by the CPU
+void benchKernels(Inputs &in) {
+  AlignedVector<float> px, py, pz, scale, qw, qx, qy, qz;
+  for (std::size_t i = 0; i < MAX_BATCH; i++) {
+    px.push_back(in.positions[i](0));
+    py.push_back(in.positions[i](1));
+    pz.push_back(in.positions[i](2));
+    scale.push_back(in.scales[i]);
+    qw.push_back(in.quats[i].w);
+    qx.push_back(in.quats[i].x);
+    qy.push_back(in.quats[i].y);
+    qz.push_back(in.quats[i].z);
+  }
+  Frustum frustum{mat::perspectiveProjection(mat::toRads(45.0f), 1.33f, 0.1f,
+                                             100.0f) *
+                  mat::lookAt(Vec3f{0.0f, 0.0f, 3.0f}, Vec3f{0.0f, 0.0f, 0.0f},
+                              Vec3f{0.0f, 1.0f, 0.0f})};
+  std::vector<std::uint32_t> visible(MAX_BATCH);
+
+  for (simd::ISA isa : {simd::ISA::SCALAR, simd::ISA::SSE4, simd::ISA::AVX2}) {
+    if (!simd::isSupported(isa))
+      continue;
+    const simd::MatrixKernels &k = simd::kernels(isa);
+    printHeader(std::string("Kernels ") + std::string(simd::isaName(isa)));
+    checkKernels(k, in,
+                 simd::TransformSoA{px.data(), py.data(), pz.data(),
+                                    scale.data(), qw.data(), qx.data(),
+                                    qy.data(), qz.data(), MAX_BATCH},
+                 simd::SphereSoA{px.data(), py.data(), pz.data(),
+                                 scale.data(), MAX_BATCH},
+                 frustum);
+    for (std::size_t n : BATCH_SIZES) {
+      measure("mat4Mul", n, [&] {
+        for (std::size_t i = 0; i < n; i++) {
+          k.mat4Mul(in.a[i].data().data(), in.b[i].data().data(),
+                    in.out[i].data().data());
+        }
+        doNotOptimize(in.out);
+      });
+    }
+    for (std::size_t n : BATCH_SIZES) {
+      measure("mat4Inverse", n, [&] {
+        for (std::size_t i = 0; i < n; i++) {
+          k.mat4Inverse(in.affine[i].data().data(), in.out[i].data().data());
+        }
+        doNotOptimize(in.out);
+      });
+    }
+    for (std::size_t n : BATCH_SIZES) {
+      measure("mat4AffineInverse", n, [&] {
+        for (std::size_t i = 0; i < n; i++) {
+          k.mat4AffineInverse(in.affine[i].data().data(),
+                              in.out[i].data().data());
+        }
+        doNotOptimize(in.out);
+      });
+    }
+    for (std::size_t n : BATCH_SIZES) {
+      simd::TransformSoA soa{px.data(), py.data(), pz.data(), scale.data(),
+                             qw.data(), qx.data(), qy.data(), qz.data(),
+                             n};
+      measure("buildModelMatrices", n, [&] {
+        k.buildModelMatrices(soa, in.out.data()->data().data());
+        doNotOptimize(in.out);
+      });
+    }
+    for (std::size_t n : BATCH_SIZES) {
+      simd::SphereSoA soa{px.data(), py.data(), pz.data(), scale.data(), n};
+      measure("cullSpheres", n, [&] {
+        std::size_t count =
+            k.cullSpheres(frustum.getPlanes().data(), soa, visible.data());
+        doNotOptimize(count);
+      });
+    }
+  }
+}
+} // namespace
+
+int main() {
+  std::printf("Math benchmarks, dispatched kernels: %.*s\n",
+              static_cast<int>(simd::isaName(simd::kernels().isa).size()),
+              simd::isaName(simd::kernels().isa).data());
+  Inputs inputs{MAX_BATCH};
+  benchMatrix(inputs);
+  benchTransforms(inputs);
+  benchQuaternions(inputs);
+  benchTrig();
+  benchEntityStorage();
+  benchJobSystem();
+  benchLightGrid();
+  benchLightClusters();
+  benchTransparentQueue();
+  benchRenderQueue();
+  benchKernels(inputs);
+}
@@ -3,11 +3,19 @@
 
 #include <cassert>
 #include <glad/glad.h>
+#include <span>
+
+#include "../math/Std140.h"
+#include "GLState.h"
 
 enum class BUFFER_TYPE {
   VAO,
   VBO,
   EBO,
+  // Storage of a buffer texture
+  TBO,
+  // Storage of a uniform block
+  UBO,
   TEXTURE,
   FBO,
   RBO,
@@ -42,6 +50,10 @@ template <BUFFER_TYPE bufferType> Buffer<bufferType>::Buffer() {
     glGenBuffers(1, &bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::EBO) {
     glGenBuffers(1, &bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::TBO) {
+    glGenBuffers(1, &bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::UBO) {
+    glGenBuffers(1, &bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::TEXTURE) {
     glGenTextures(1, &bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::FBO) {
@@ -62,16 +74,27 @@ template <BUFFER_TYPE bufferType> Buffer<bufferType>::Buffer() {
 }
 
 template <BUFFER_TYPE bufferType> Buffer<bufferType>::~Buffer() {
+  // GL unbinds the deleted objects
   if constexpr (bufferType == BUFFER_TYPE::VAO) {
     glDeleteVertexArrays(1, &bufferID);
+    GLState::get().vertexArrayDeleted(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::VBO) {
     glDeleteBuffers(1, &bufferID);
+    GLState::get().bufferDeleted(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::EBO) {
     glDeleteBuffers(1, &bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::TBO) {
+    glDeleteBuffers(1, &bufferID);
+    GLState::get().bufferDeleted(bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::UBO) {
+    glDeleteBuffers(1, &bufferID);
+    GLState::get().bufferDeleted(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::TEXTURE) {
     glDeleteTextures(1, &bufferID);
+    GLState::get().textureDeleted(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::FBO) {
     glDeleteFramebuffers(1, &bufferID);
+    GLState::get().framebufferDeleted(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::RBO) {
     glDeleteRenderbuffers(1, &bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::SHADER_PROGRAM) {
@@ -87,25 +110,43 @@ template <BUFFER_TYPE bufferType> Buffer<bufferType>::~Buffer() {
   }
 }
 
+// Through GLState, binding the bound object again is skipped
 template <BUFFER_TYPE bufferType> void Buffer<bufferType>::bind() const {
+  GLState &state = GLState::get();
   if constexpr (bufferType == BUFFER_TYPE::VAO) {
-    glBindVertexArray(bufferID);
+    state.bindVertexArray(bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::VBO) {
-    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+    state.bindBuffer(GL_ARRAY_BUFFER, bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::EBO) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::TBO) {
+    state.bindBuffer(GL_TEXTURE_BUFFER, bufferID);
+  } else if constexpr (bufferType == BUFFER_TYPE::UBO) {
+    state.bindBuffer(GL_UNIFORM_BUFFER, bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::TEXTURE) {
-    glBindTexture(GL_TEXTURE_2D, bufferID);
+    state.bindTexture(GL_TEXTURE_2D, bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::FBO) {
-    glBindFramebuffer(GL_FRAMEBUFFER, bufferID);
+    state.bindFramebuffer(GL_FRAMEBUFFER, bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::RBO) {
     glBindRenderbuffer(GL_RENDERBUFFER, bufferID);
   } else if constexpr (bufferType == BUFFER_TYPE::SHADER_PROGRAM) {
-    glUseProgram(bufferID);
+    state.useProgram(bufferID);
   } else {
     // Not bindable...
     static_assert(false);
   }
 }
 
+/**
+ * Copy a contiguous array into the buffer bound to target, zero-copy on the
+ * CPU side: the memory is handed straight to OpenGL without repacking.
+ * @param target - binding point, for example GL_UNIFORM_BUFFER
+ * @param offset - offset in bytes from the start of the buffer
+ * @param data - elements to upload
+ */
+template <Std140Compatible T>
+void bufferSubData(GLenum target, GLintptr offset, std::span<const T> data) {
+  glBufferSubData(target, offset, data.size_bytes(), data.data());
+}
+
 #endif // BUFFER_C
\ No newline at end of file
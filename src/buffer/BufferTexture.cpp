@@ -0,0 +1,12 @@
+#include "BufferTexture.h"
+
+BufferTexture::BufferTexture(GLenum internalFormat) {
+  storage.bind();
+  glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+  GLState::get().bindTexture(GL_TEXTURE_BUFFER, texture.getID());
+  glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, storage.getID());
+}
+
+void BufferTexture::bind(int textureUnit) const {
+  GLState::get().bindTexture(textureUnit, GL_TEXTURE_BUFFER, texture.getID());
+}
@@ -0,0 +1,45 @@
+#ifndef BUFFER_TEXTURE_C
+#define BUFFER_TEXTURE_C
+
+#include <algorithm>
+#include <span>
+
+#include "Buffer.h"
+
+/**
+ * Buffer read by the shaders through texelFetch on a samplerBuffer (or
+ * usamplerBuffer), for arrays too large for uniforms. Not copyable nor
+ * movable, like Buffer.
+ */
+class BufferTexture {
+private:
+  Buffer<BUFFER_TYPE::TBO> storage;
+  Buffer<BUFFER_TYPE::TEXTURE> texture;
+
+public:
+  /**
+   * @param internalFormat - format of the texels, for example GL_RGBA32F
+   */
+  explicit BufferTexture(GLenum internalFormat);
+  BufferTexture(const BufferTexture &buffer) = delete;
+  BufferTexture(BufferTexture &&buffer) = delete;
+  /**
+   * Replace the content of the buffer. The storage is reallocated on every
+   * upload, so the driver doesn't wait for the draws still reading the old
+   * one.
+   */
+  template <Std140Compatible T> void upload(std::span<const T> data);
+  // Bind the texture to GL_TEXTURE0 + textureUnit
+  void bind(int textureUnit) const;
+};
+
+template <Std140Compatible T>
+void BufferTexture::upload(std::span<const T> data) {
+  storage.bind();
+  // At least a texel, so the texture never has a zero sized storage
+  glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(data.size_bytes(), 16),
+               nullptr, GL_STREAM_DRAW);
+  bufferSubData(GL_TEXTURE_BUFFER, 0, data);
+}
+
+#endif // BUFFER_TEXTURE_C
@@ -1,19 +1,41 @@
 #include "FrameBuffer.h"
 
+#include <cstddef>
 #include <glad/glad.h>
 #include <stdexcept>
 
-FrameBuffer::FrameBuffer(float bufferWidth, float bufferHeight) {
+static constexpr ColorFormat RGB_COLOR{GL_RGB, GL_RGB, GL_UNSIGNED_BYTE};
+
+FrameBuffer::FrameBuffer(float bufferWidth, float bufferHeight)
+    : FrameBuffer(bufferWidth, bufferHeight,
+                  std::span<const ColorFormat>(&RGB_COLOR, 1)) {}
+
+FrameBuffer::FrameBuffer(float bufferWidth, float bufferHeight,
+                         std::span<const ColorFormat> colorFormats) {
+  GLint maxAttachments = 0;
+  glGetIntegerv(GL_MAX_COLOR_ATTACHMENTS, &maxAttachments);
+  if (colorFormats.empty() || maxAttachments < 0 ||
+      colorFormats.size() > static_cast<std::size_t>(maxAttachments)) {
+    throw std::runtime_error("Unsupported number of color attachments");
+  }
   rawBuffer = std::make_unique<RawFrameBuffer>();
   rawBuffer->fbo.bind();
 
-  rawBuffer->color.bind();
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, bufferWidth, bufferHeight, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         rawBuffer->color.getID(), 0);
+  std::vector<GLenum> drawBuffers;
+  for (const ColorFormat &colorFormat : colorFormats) {
+    const GLenum attachment = GL_COLOR_ATTACHMENT0 + drawBuffers.size();
+    auto &color = rawBuffer->colors.emplace_back(
+        std::make_unique<Buffer<BUFFER_TYPE::TEXTURE>>());
+    color->bind();
+    glTexImage2D(GL_TEXTURE_2D, 0, colorFormat.internalFormat, bufferWidth,
+                 bufferHeight, 0, colorFormat.format, colorFormat.type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                           color->getID(), 0);
+    drawBuffers.push_back(attachment);
+  }
+  glDrawBuffers(drawBuffers.size(), drawBuffers.data());
 
   rawBuffer->depth_stencil.bind();
   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, bufferWidth,
@@ -24,5 +46,22 @@ FrameBuffer::FrameBuffer(float bufferWidth, float bufferHeight) {
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     throw std::runtime_error("Frame Buffer is not complete!");
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
\ No newline at end of file
+  GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameBuffer::bindColor(std::size_t attachment) const {
+  rawBuffer->colors.at(attachment)->bind();
+}
+
+void FrameBuffer::setDrawBuffers(
+    std::span<const unsigned int> attachments) const {
+  bind();
+  std::vector<GLenum> drawBuffers;
+  for (unsigned int attachment : attachments) {
+    if (attachment >= rawBuffer->colors.size()) {
+      throw std::runtime_error("Draw buffer without a color attachment");
+    }
+    drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + attachment);
+  }
+  glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+}
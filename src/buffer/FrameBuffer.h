@@ -2,14 +2,23 @@
 #define FRAME_BUFFER_C
 
 #include <memory>
+#include <span>
+#include <vector>
 
 #include "Buffer.h"
 
-// Color buffer + depth buffer + stencil buffer
+// Format of a color attachment, the arguments of glTexImage2D
+struct ColorFormat {
+  GLint internalFormat;
+  GLenum format;
+  GLenum type;
+};
+
+// Color buffers + depth buffer + stencil buffer
 struct RawFrameBuffer {
   Buffer<BUFFER_TYPE::FBO> fbo;
-  // TODO: This is not the most general frame buffer
-  Buffer<BUFFER_TYPE::TEXTURE> color;
+  // Buffer is not movable
+  std::vector<std::unique_ptr<Buffer<BUFFER_TYPE::TEXTURE>>> colors;
   Buffer<BUFFER_TYPE::RBO> depth_stencil;
 };
 class FrameBuffer {
@@ -17,11 +26,25 @@ private:
   std::unique_ptr<RawFrameBuffer> rawBuffer;
 
 public:
+  // Single GL_RGB color texture
   FrameBuffer(float bufferWidth, float bufferHeight);
+  /**
+   * Multiple render targets, color attachment i has format colorFormats[i].
+   * All of them are draw buffers until setDrawBuffers is called
+   */
+  FrameBuffer(float bufferWidth, float bufferHeight,
+              std::span<const ColorFormat> colorFormats);
   FrameBuffer(FrameBuffer &&buffer) = default;
   FrameBuffer(const FrameBuffer &buffer) = delete;
   void bind() const { rawBuffer->fbo.bind(); }
-  void bindColor() const { rawBuffer->color.bind(); }
+  void bindColor() const { bindColor(0); }
+  void bindColor(std::size_t attachment) const;
+  std::size_t getColorCount() const { return rawBuffer->colors.size(); }
+  /**
+   * Bind the frame buffer and select the attachments written by the
+   * fragment shader outputs: output i goes to attachments[i]
+   */
+  void setDrawBuffers(std::span<const unsigned int> attachments) const;
 };
 
-#endif // FRAME_BUFFER_C
\ No newline at end of file
+#endif // FRAME_BUFFER_C
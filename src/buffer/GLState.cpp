@@ -0,0 +1,199 @@
+#include "GLState.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+// Index of value in values, values.size() if missing
+template <std::size_t N>
+static std::size_t indexOf(const std::array<GLenum, N> &values,
+                           GLenum value) {
+  return std::ranges::find(values, value) - values.begin();
+}
+
+// Binding queried by glGet for the cached targets
+static constexpr std::array<GLenum, 3> BUFFER_BINDINGS = {
+    GL_ARRAY_BUFFER_BINDING, GL_TEXTURE_BUFFER, GL_UNIFORM_BUFFER_BINDING};
+static constexpr std::array<GLenum, 2> TEXTURE_BINDINGS = {
+    GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_BUFFER};
+
+GLState &GLState::get() {
+  static GLState state;
+  return state;
+}
+
+bool GLState::changed(bool different) {
+  if (different) {
+    stats.changes++;
+  } else {
+    stats.skipped++;
+  }
+  return different;
+}
+
+void GLState::validate(GLenum name, GLint cached) const {
+  if (!validation)
+    return;
+  GLint actual = 0;
+  glGetIntegerv(name, &actual);
+  if (actual != cached) {
+    throw std::runtime_error(std::format(
+        "GL state 0x{:X} is {}, cached {}", name, actual, cached));
+  }
+}
+
+void GLState::useProgram(GLuint id) {
+  validate(GL_CURRENT_PROGRAM, program);
+  if (changed(id != program)) {
+    glUseProgram(id);
+    program = id;
+  }
+}
+
+GLuint GLState::getProgram() const {
+  validate(GL_CURRENT_PROGRAM, program);
+  return program;
+}
+
+void GLState::bindVertexArray(GLuint id) {
+  validate(GL_VERTEX_ARRAY_BINDING, vertexArray);
+  if (changed(id != vertexArray)) {
+    glBindVertexArray(id);
+    vertexArray = id;
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+  const std::size_t i = indexOf(BUFFER_TARGETS, target);
+  if (i == BUFFER_TARGETS.size()) {
+    glBindBuffer(target, buffer);
+    return;
+  }
+  validate(BUFFER_BINDINGS[i], buffers[i]);
+  if (changed(buffer != buffers[i])) {
+    glBindBuffer(target, buffer);
+    buffers[i] = buffer;
+  }
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  glBindBufferBase(target, index, buffer);
+  const std::size_t i = indexOf(BUFFER_TARGETS, target);
+  if (i != BUFFER_TARGETS.size()) {
+    buffers[i] = buffer;
+  }
+}
+
+void GLState::activeTexture(unsigned int unit) {
+  validate(GL_ACTIVE_TEXTURE, GL_TEXTURE0 + activeUnit);
+  if (changed(unit != activeUnit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+  }
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture) {
+  const std::size_t i = indexOf(TEXTURE_TARGETS, target);
+  if (i == TEXTURE_TARGETS.size() || activeUnit >= MAX_TEXTURE_UNITS) {
+    glBindTexture(target, texture);
+    return;
+  }
+  GLuint &bound = textures[activeUnit][i];
+  validate(GL_ACTIVE_TEXTURE, GL_TEXTURE0 + activeUnit);
+  validate(TEXTURE_BINDINGS[i], bound);
+  if (changed(texture != bound)) {
+    glBindTexture(target, texture);
+    bound = texture;
+  }
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer) {
+  const bool draw = target != GL_READ_FRAMEBUFFER;
+  const bool read = target != GL_DRAW_FRAMEBUFFER;
+  if (draw) {
+    validate(GL_DRAW_FRAMEBUFFER_BINDING, drawFramebuffer);
+  }
+  if (read) {
+    validate(GL_READ_FRAMEBUFFER_BINDING, readFramebuffer);
+  }
+  if (changed((draw && framebuffer != drawFramebuffer) ||
+              (read && framebuffer != readFramebuffer))) {
+    glBindFramebuffer(target, framebuffer);
+    if (draw) {
+      drawFramebuffer = framebuffer;
+    }
+    if (read) {
+      readFramebuffer = framebuffer;
+    }
+  }
+}
+
+GLuint GLState::getDrawFramebuffer() const {
+  validate(GL_DRAW_FRAMEBUFFER_BINDING, drawFramebuffer);
+  return drawFramebuffer;
+}
+
+void GLState::setEnabled(GLenum capability, bool enable) {
+  const std::size_t i = indexOf(CAPABILITIES, capability);
+  if (i == CAPABILITIES.size()) {
+    enable ? glEnable(capability) : glDisable(capability);
+    return;
+  }
+  if (validation && glIsEnabled(capability) != enabled[i]) {
+    throw std::runtime_error(
+        std::format("GL capability 0x{:X} not cached", capability));
+  }
+  if (changed(enable != enabled[i])) {
+    enable ? glEnable(capability) : glDisable(capability);
+    enabled[i] = enable;
+  }
+}
+
+void GLState::depthMask(bool enable) {
+  validate(GL_DEPTH_WRITEMASK, depthWrite);
+  if (changed(enable != depthWrite)) {
+    glDepthMask(enable ? GL_TRUE : GL_FALSE);
+    depthWrite = enable;
+  }
+}
+
+void GLState::blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb,
+                                GLenum sourceAlpha, GLenum destinationAlpha) {
+  static constexpr GLenum NAMES[] = {GL_BLEND_SRC_RGB, GL_BLEND_DST_RGB,
+                                     GL_BLEND_SRC_ALPHA, GL_BLEND_DST_ALPHA};
+  for (std::size_t i = 0; i < blend.size(); i++) {
+    validate(NAMES[i], blend[i]);
+  }
+  const std::array<GLenum, 4> factors = {sourceRgb, destinationRgb,
+                                         sourceAlpha, destinationAlpha};
+  if (changed(factors != blend)) {
+    glBlendFuncSeparate(sourceRgb, destinationRgb, sourceAlpha,
+                        destinationAlpha);
+    blend = factors;
+  }
+}
+
+void GLState::vertexArrayDeleted(GLuint id) {
+  if (vertexArray == id) {
+    vertexArray = 0;
+  }
+}
+
+void GLState::bufferDeleted(GLuint buffer) {
+  std::ranges::replace(buffers, buffer, 0u);
+}
+
+void GLState::textureDeleted(GLuint texture) {
+  for (auto &unit : textures) {
+    std::ranges::replace(unit, texture, 0u);
+  }
+}
+
+void GLState::framebufferDeleted(GLuint framebuffer) {
+  if (drawFramebuffer == framebuffer) {
+    drawFramebuffer = 0;
+  }
+  if (readFramebuffer == framebuffer) {
+    readFramebuffer = 0;
+  }
+}
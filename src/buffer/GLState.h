@@ -0,0 +1,103 @@
+#ifndef GL_STATE_C
+#define GL_STATE_C
+
+#include <array>
+#include <cstddef>
+#include <glad/glad.h>
+
+/**
+ * Cache of the OpenGL state changed by the engine: program, vertex array,
+ * buffer bindings, textures of each unit, frame buffers, capabilities,
+ * depth and blend state. Changes to the current value don't reach the
+ * driver, and the bindings are read back without a synchronous glGet.
+ * The cache starts from the state of a new context and holds as long as
+ * these changes go through it. With validation enabled every change and
+ * query first checks the cache against glGet, a mismatch throws.
+ */
+class GLState {
+public:
+  // Changes issued to the driver and skipped since the start
+  struct Stats {
+    std::size_t changes = 0;
+    std::size_t skipped = 0;
+  };
+
+  // State of the current context, there is a single one
+  static GLState &get();
+  void setValidation(bool enabled) { validation = enabled; }
+  const Stats &getStats() const { return stats; }
+
+  void useProgram(GLuint program);
+  GLuint getProgram() const;
+  void bindVertexArray(GLuint vertexArray);
+  /**
+   * GL_ARRAY_BUFFER, GL_TEXTURE_BUFFER and GL_UNIFORM_BUFFER are cached.
+   * Other targets, like GL_ELEMENT_ARRAY_BUFFER which belongs to the vertex
+   * array, are always bound
+   */
+  void bindBuffer(GLenum target, GLuint buffer);
+  // Bind to an indexed binding point, and to the generic one like GL does
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  // Texture unit of the next bindTexture, from 0
+  void activeTexture(unsigned int unit);
+  /**
+   * Bind to the active unit. GL_TEXTURE_2D and GL_TEXTURE_BUFFER are
+   * cached for the first MAX_TEXTURE_UNITS units
+   */
+  void bindTexture(GLenum target, GLuint texture);
+  void bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+    activeTexture(unit);
+    bindTexture(target, texture);
+  }
+  // GL_FRAMEBUFFER binds both the draw and the read frame buffers
+  void bindFramebuffer(GLenum target, GLuint framebuffer);
+  GLuint getDrawFramebuffer() const;
+  // Capabilities of glEnable, the ones of CAPABILITIES are cached
+  void setEnabled(GLenum capability, bool enabled);
+  void enable(GLenum capability) { setEnabled(capability, true); }
+  void disable(GLenum capability) { setEnabled(capability, false); }
+  void depthMask(bool enabled);
+  void blendFunc(GLenum source, GLenum destination) {
+    blendFuncSeparate(source, destination, source, destination);
+  }
+  void blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb,
+                         GLenum sourceAlpha, GLenum destinationAlpha);
+
+  // Deleted objects are unbound by GL, called by the Buffer destructors
+  void vertexArrayDeleted(GLuint vertexArray);
+  void bufferDeleted(GLuint buffer);
+  void textureDeleted(GLuint texture);
+  void framebufferDeleted(GLuint framebuffer);
+
+private:
+  static constexpr std::size_t MAX_TEXTURE_UNITS = 32;
+  static constexpr std::array<GLenum, 3> BUFFER_TARGETS = {
+      GL_ARRAY_BUFFER, GL_TEXTURE_BUFFER, GL_UNIFORM_BUFFER};
+  static constexpr std::array<GLenum, 2> TEXTURE_TARGETS = {GL_TEXTURE_2D,
+                                                            GL_TEXTURE_BUFFER};
+  static constexpr std::array<GLenum, 6> CAPABILITIES = {
+      GL_BLEND,        GL_DEPTH_TEST, GL_STENCIL_TEST,
+      GL_SCISSOR_TEST, GL_CULL_FACE,  GL_FRAMEBUFFER_SRGB};
+
+  bool validation = false;
+  Stats stats;
+  GLuint program = 0;
+  GLuint vertexArray = 0;
+  std::array<GLuint, BUFFER_TARGETS.size()> buffers{};
+  unsigned int activeUnit = 0;
+  std::array<std::array<GLuint, TEXTURE_TARGETS.size()>, MAX_TEXTURE_UNITS>
+      textures{};
+  GLuint drawFramebuffer = 0;
+  GLuint readFramebuffer = 0;
+  std::array<bool, CAPABILITIES.size()> enabled{};
+  bool depthWrite = true;
+  std::array<GLenum, 4> blend = {GL_ONE, GL_ZERO, GL_ONE, GL_ZERO};
+
+  GLState() = default;
+  // Count a change, returns whether it must be issued
+  bool changed(bool different);
+  // Throw if the driver value of name isn't cached, with validation
+  void validate(GLenum name, GLint cached) const;
+};
+
+#endif // GL_STATE_C
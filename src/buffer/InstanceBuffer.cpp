@@ -0,0 +1,43 @@
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+void InstanceData::setModelMatrix(const Mat4f &m) {
+  std::copy_n(m.data().data(), 16, modelMatrix);
+}
+
+void InstanceData::setNormalMatrix(const Mat3f &m) {
+  std::copy_n(m.data().data(), 9, normalMatrix);
+}
+
+void InstanceData::setColor(const Vec3f &c) {
+  std::copy_n(c.data().data(), 3, color);
+}
+
+void InstanceBuffer::upload(std::span<const InstanceData> instances) {
+  vbo.bind();
+  glBufferData(GL_ARRAY_BUFFER, instances.size_bytes(), instances.data(),
+               GL_STREAM_DRAW);
+  count = instances.size();
+}
+
+// Attribute advanced once per instance, a matrix takes a location per
+// column
+static void instanceAttribute(GLuint location, int columns, int rows,
+                              std::size_t offset) {
+  for (int c = 0; c < columns; c++) {
+    glEnableVertexAttribArray(location + c);
+    glVertexAttribPointer(location + c, rows, GL_FLOAT, GL_FALSE,
+                          sizeof(InstanceData),
+                          (void *)(offset + c * rows * sizeof(float)));
+    glVertexAttribDivisor(location + c, 1);
+  }
+}
+
+void InstanceBuffer::setupAttributes() const {
+  vbo.bind();
+  instanceAttribute(MODEL_MATRIX, 4, 4, offsetof(InstanceData, modelMatrix));
+  instanceAttribute(NORMAL_MATRIX, 3, 3, offsetof(InstanceData, normalMatrix));
+  instanceAttribute(COLOR, 1, 3, offsetof(InstanceData, color));
+}
@@ -0,0 +1,53 @@
+#ifndef INSTANCE_BUFFER_C
+#define INSTANCE_BUFFER_C
+
+#include <span>
+
+#include "../math/Matrix.h"
+#include "Buffer.h"
+
+// Per instance vertex attributes, C style arrays like Vertex
+struct InstanceData {
+  // Model matrix, column major
+  float modelMatrix[16];
+  // Normal matrix, column major
+  float normalMatrix[9];
+  float color[3];
+
+  void setModelMatrix(const Mat4f &m);
+  void setNormalMatrix(const Mat3f &m);
+  void setColor(const Vec3f &c);
+};
+
+/**
+ * Vertex buffer of the attributes of the instances drawn by
+ * Mesh::renderInstanced. They use the attribute locations from
+ * FIRST_ATTRIBUTE: the model matrix (4 vec4), the normal matrix (3 vec3)
+ * and the color. Not copyable nor movable, like Buffer.
+ */
+class InstanceBuffer {
+public:
+  static constexpr GLuint FIRST_ATTRIBUTE = 3;
+  static constexpr GLuint MODEL_MATRIX = FIRST_ATTRIBUTE;
+  static constexpr GLuint NORMAL_MATRIX = MODEL_MATRIX + 4;
+  static constexpr GLuint COLOR = NORMAL_MATRIX + 3;
+
+  InstanceBuffer() = default;
+  InstanceBuffer(const InstanceBuffer &buffer) = delete;
+  InstanceBuffer(InstanceBuffer &&buffer) = delete;
+  GLuint getID() const { return vbo.getID(); }
+  std::size_t size() const { return count; }
+  /**
+   * Replace the instances. The storage is reallocated on every upload, so
+   * the driver doesn't wait for the draws still reading the old one
+   */
+  void upload(std::span<const InstanceData> instances);
+  // Point the instance attributes of the bound vertex array to the buffer
+  void setupAttributes() const;
+
+private:
+  Buffer<BUFFER_TYPE::VBO> vbo;
+  std::size_t count = 0;
+};
+
+#endif // INSTANCE_BUFFER_C
@@ -0,0 +1,9 @@
+#include "UniformBuffer.h"
+
+UniformBuffer::UniformBuffer(GLsizeiptr capacity, GLuint bindingPoint)
+    : capacity{capacity} {
+  storage.bind();
+  glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+  GLState::get().bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint,
+                                storage.getID());
+}
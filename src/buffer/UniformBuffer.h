@@ -0,0 +1,46 @@
+#ifndef UNIFORM_BUFFER_C
+#define UNIFORM_BUFFER_C
+
+#include <span>
+#include <stdexcept>
+
+#include "Buffer.h"
+
+/**
+ * Storage of a std140 uniform block, shared by all the programs whose block
+ * is assigned to the same binding point. Not copyable nor movable, like
+ * Buffer.
+ */
+class UniformBuffer {
+private:
+  Buffer<BUFFER_TYPE::UBO> storage;
+  GLsizeiptr capacity;
+
+public:
+  /**
+   * @param capacity - size of the block in bytes
+   * @param bindingPoint - index the programs bind their block to with
+   * glUniformBlockBinding
+   */
+  UniformBuffer(GLsizeiptr capacity, GLuint bindingPoint);
+  UniformBuffer(const UniformBuffer &buffer) = delete;
+  UniformBuffer(UniformBuffer &&buffer) = delete;
+  /**
+   * Replace the start of the block, the rest is undefined. The storage is
+   * reallocated on every upload, so the driver doesn't wait for the draws
+   * still reading the old one.
+   */
+  template <Std140Compatible T> void upload(std::span<const T> data);
+};
+
+template <Std140Compatible T>
+void UniformBuffer::upload(std::span<const T> data) {
+  if (data.size_bytes() > static_cast<std::size_t>(capacity)) {
+    throw std::runtime_error("Data larger than the uniform block");
+  }
+  storage.bind();
+  glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+  bufferSubData(GL_UNIFORM_BUFFER, 0, data);
+}
+
+#endif // UNIFORM_BUFFER_C
@@ -0,0 +1,41 @@
+#include "World.h"
+
+namespace ecs {
+ComponentId detail::nextComponentId() {
+  static ComponentId next = 0;
+  if (next == MAX_COMPONENTS) {
+    throw std::runtime_error("Too many component types");
+  }
+  return next++;
+}
+
+EntityId World::allocateId() {
+  if (!freeIds.empty()) {
+    EntityId id = freeIds.back();
+    freeIds.pop_back();
+    return id;
+  }
+  locations.push_back({DEAD, 0});
+  return locations.size() - 1;
+}
+
+void World::destroy(EntityId id) {
+  if (!isAlive(id)) {
+    throw std::runtime_error("Destroying a dead entity");
+  }
+  const Location loc = locations[id];
+  Archetype &archetype = *archetypes[loc.archetype];
+  for (auto &column : archetype.columns) {
+    if (column) {
+      column->swapRemove(loc.row);
+    }
+  }
+  // The last entity takes the place of the removed one
+  const EntityId moved = archetype.entities.back();
+  archetype.entities[loc.row] = moved;
+  archetype.entities.pop_back();
+  locations[moved].row = loc.row;
+  locations[id].archetype = DEAD;
+  freeIds.push_back(id);
+}
+} // namespace ecs
@@ -0,0 +1,249 @@
+#ifndef WORLD_C
+#define WORLD_C
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Archetype based entity-component storage.
+ * Entities with the same set of component types share an Archetype, which
+ * stores each component type in its own contiguous column: systems sweep
+ * the columns linearly instead of chasing pointers to scattered objects.
+ * The archetype of an entity is fixed when it's created.
+ */
+namespace ecs {
+using EntityId = std::uint32_t;
+inline constexpr EntityId NO_ENTITY = std::numeric_limits<EntityId>::max();
+
+using ComponentId = std::uint32_t;
+inline constexpr std::size_t MAX_COMPONENTS = 64;
+using ComponentMask = std::bitset<MAX_COMPONENTS>;
+
+namespace detail {
+// Throws when more than MAX_COMPONENTS types are registered
+ComponentId nextComponentId();
+
+template <typename C> ComponentId typeId() {
+  static const ComponentId id = nextComponentId();
+  return id;
+}
+} // namespace detail
+
+// Dense id of a component type, assigned at the first use.
+// C and const C are the same component.
+template <typename C> ComponentId componentId() {
+  return detail::typeId<std::remove_cv_t<C>>();
+}
+
+template <typename... Cs> ComponentMask componentMask() {
+  ComponentMask mask;
+  (mask.set(componentId<Cs>()), ...);
+  return mask;
+}
+
+// Type erased column of an archetype
+class ColumnBase {
+public:
+  virtual ~ColumnBase() = default;
+  // Remove a row moving the last one in its place
+  virtual void swapRemove(std::size_t row) = 0;
+};
+
+template <typename C> class Column : public ColumnBase {
+public:
+  std::vector<C> data;
+  void swapRemove(std::size_t row) override {
+    if (row + 1 != data.size()) {
+      data[row] = std::move(data.back());
+    }
+    data.pop_back();
+  }
+};
+
+class Archetype {
+public:
+  explicit Archetype(ComponentMask mask) : mask{mask} {};
+  const ComponentMask &getMask() const { return mask; }
+  std::size_t size() const { return entities.size(); }
+  // Entity of each row
+  std::span<const EntityId> getEntities() const { return entities; }
+  template <typename C> std::span<C> column() {
+    ColumnBase *col = columns[componentId<C>()].get();
+    if (!col) {
+      throw std::runtime_error("Archetype without the requested component");
+    }
+    return static_cast<Column<std::remove_cv_t<C>> *>(col)->data;
+  }
+
+private:
+  friend class World;
+  ComponentMask mask;
+  std::vector<EntityId> entities;
+  // Indexed by component id, nullptr for the missing components
+  std::array<std::unique_ptr<ColumnBase>, MAX_COMPONENTS> columns;
+};
+
+class World;
+
+/**
+ * Entities having all the components Cs and none of the excluded ones.
+ * Structural changes (create, destroy) invalidate a running iteration.
+ */
+template <typename... Cs> class Query {
+public:
+  explicit Query(World &world)
+      : world{world}, include{componentMask<Cs...>()} {};
+  template <typename... Ts> Query &without() {
+    exclude |= componentMask<Ts...>();
+    return *this;
+  }
+  /**
+   * Call fn(Cs &...), or fn(EntityId, Cs &...), for every entity
+   */
+  template <typename Fn> void each(Fn &&fn);
+  /**
+   * Call fn(std::span<const EntityId>, std::span<Cs>...) once per
+   * matching archetype, for sweeps over whole columns
+   */
+  template <typename Fn> void eachArchetype(Fn &&fn);
+  std::size_t count();
+
+private:
+  World &world;
+  ComponentMask include;
+  ComponentMask exclude;
+};
+
+class World {
+public:
+  /**
+   * Create an entity with the given components, each type at most once
+   * @return id of the entity, ids of destroyed entities are reused
+   */
+  template <typename... Cs> EntityId create(Cs &&...components);
+  void destroy(EntityId id);
+  bool isAlive(EntityId id) const {
+    return id < locations.size() && locations[id].archetype != DEAD;
+  }
+  // Number of alive entities
+  std::size_t size() const { return locations.size() - freeIds.size(); }
+
+  template <typename C> bool has(EntityId id) const {
+    return isAlive(id) &&
+           archetypes[locations[id].archetype]->mask.test(componentId<C>());
+  }
+  // Throws if the entity is dead or doesn't have the component
+  template <typename C> C &get(EntityId id);
+  template <typename C> const C &get(EntityId id) const {
+    return const_cast<World *>(this)->get<C>(id);
+  }
+
+  template <typename... Cs> Query<Cs...> query() {
+    return Query<Cs...>{*this};
+  }
+
+private:
+  template <typename... Cs> friend class Query;
+  static constexpr std::uint32_t DEAD =
+      std::numeric_limits<std::uint32_t>::max();
+  struct Location {
+    std::uint32_t archetype;
+    std::uint32_t row;
+  };
+  // unique_ptr keeps archetypes in place when new ones are added
+  std::vector<std::unique_ptr<Archetype>> archetypes;
+  std::unordered_map<ComponentMask, std::uint32_t> archetypeIds;
+  // Indexed by entity id
+  std::vector<Location> locations;
+  std::vector<EntityId> freeIds;
+
+  template <typename... Cs> std::uint32_t findOrCreateArchetype();
+  EntityId allocateId();
+};
+
+template <typename... Cs> std::uint32_t World::findOrCreateArchetype() {
+  const ComponentMask mask = componentMask<Cs...>();
+  if (mask.count() != sizeof...(Cs)) {
+    throw std::runtime_error("Entity with a repeated component type");
+  }
+  auto it = archetypeIds.find(mask);
+  if (it != archetypeIds.end())
+    return it->second;
+  auto archetype = std::make_unique<Archetype>(mask);
+  ((archetype->columns[componentId<Cs>()] =
+        std::make_unique<Column<std::remove_cvref_t<Cs>>>()),
+   ...);
+  archetypes.push_back(std::move(archetype));
+  const std::uint32_t id = archetypes.size() - 1;
+  archetypeIds.emplace(mask, id);
+  return id;
+}
+
+template <typename... Cs> EntityId World::create(Cs &&...components) {
+  const std::uint32_t archetypeId =
+      findOrCreateArchetype<std::remove_cvref_t<Cs>...>();
+  Archetype &archetype = *archetypes[archetypeId];
+  const EntityId id = allocateId();
+  locations[id] = {archetypeId, static_cast<std::uint32_t>(archetype.size())};
+  archetype.entities.push_back(id);
+  (static_cast<Column<std::remove_cvref_t<Cs>> *>(
+       archetype.columns[componentId<std::remove_cvref_t<Cs>>()].get())
+       ->data.push_back(std::forward<Cs>(components)),
+   ...);
+  return id;
+}
+
+template <typename C> C &World::get(EntityId id) {
+  if (!isAlive(id)) {
+    throw std::runtime_error("Access to a dead entity");
+  }
+  const Location &loc = locations[id];
+  return archetypes[loc.archetype]->column<C>()[loc.row];
+}
+
+template <typename... Cs>
+template <typename Fn>
+void Query<Cs...>::eachArchetype(Fn &&fn) {
+  for (const auto &archetype : world.archetypes) {
+    const ComponentMask &mask = archetype->getMask();
+    if ((mask & include) != include || (mask & exclude).any() ||
+        archetype->size() == 0)
+      continue;
+    fn(archetype->getEntities(), archetype->template column<Cs>()...);
+  }
+}
+
+template <typename... Cs>
+template <typename Fn>
+void Query<Cs...>::each(Fn &&fn) {
+  eachArchetype([&](std::span<const EntityId> entities,
+                    std::span<Cs>... columns) {
+    for (std::size_t row = 0; row < entities.size(); row++) {
+      if constexpr (std::is_invocable_v<Fn &, EntityId, Cs &...>) {
+        fn(entities[row], columns[row]...);
+      } else {
+        fn(columns[row]...);
+      }
+    }
+  });
+}
+
+template <typename... Cs> std::size_t Query<Cs...>::count() {
+  std::size_t res = 0;
+  eachArchetype([&](std::span<const EntityId> entities, std::span<Cs>...) {
+    res += entities.size();
+  });
+  return res;
+}
+} // namespace ecs
+
+#endif // WORLD_C
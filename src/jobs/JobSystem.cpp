@@ -0,0 +1,121 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <optional>
+
+JobSystem::JobSystem(std::size_t threadCount) {
+  // hardware_concurrency returns 0 when it's not computable
+  threadCount = std::max<std::size_t>(threadCount, 1);
+  for (std::size_t i = 0; i < threadCount; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+  for (std::size_t i = 1; i < threadCount; i++) {
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock(sleepMutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void JobSystem::parallelFor(std::size_t n, std::size_t chunkSize,
+                            const RangeFn &fn) {
+  if (n == 0)
+    return;
+  chunkSize = std::max<std::size_t>(chunkSize, 1);
+  const std::size_t chunks = (n + chunkSize - 1) / chunkSize;
+  if (workers.empty() || chunks == 1) {
+    for (std::size_t begin = 0; begin < n; begin += chunkSize) {
+      fn(begin, std::min(begin + chunkSize, n));
+    }
+    return;
+  }
+
+  Batch batch{&fn, chunks};
+  // Counted before the push, a thread may pop a job as soon as it's queued
+  queuedJobs.fetch_add(chunks);
+  // Contiguous chunks go to the same queue, the threads start
+  // from different regions of memory
+  const std::size_t perQueue = (chunks + queues.size() - 1) / queues.size();
+  for (std::size_t q = 0; q < queues.size(); q++) {
+    std::lock_guard lock(queues[q]->mutex);
+    const std::size_t last = std::min(chunks, (q + 1) * perQueue);
+    // Pushed in reverse, the owner pops from the back
+    for (std::size_t c = last; c-- > q * perQueue;) {
+      queues[q]->jobs.push_back(
+          Job{&batch, c * chunkSize, std::min((c + 1) * chunkSize, n)});
+    }
+  }
+  {
+    std::lock_guard lock(sleepMutex);
+  }
+  wakeUp.notify_all();
+
+  while (batch.remaining.load() > 0) {
+    if (runJob(0))
+      continue;
+    // Nothing left to steal, the last chunks are running on other threads
+    std::unique_lock lock(sleepMutex);
+    batchDone.wait(lock, [&] { return batch.remaining.load() == 0; });
+  }
+  if (batch.error) {
+    std::rethrow_exception(batch.error);
+  }
+}
+
+bool JobSystem::runJob(std::size_t queue) {
+  std::optional<Job> job;
+  {
+    WorkQueue &own = *queues[queue];
+    std::lock_guard lock(own.mutex);
+    if (!own.jobs.empty()) {
+      job = own.jobs.back();
+      own.jobs.pop_back();
+    }
+  }
+  for (std::size_t k = 1; !job && k < queues.size(); k++) {
+    WorkQueue &victim = *queues[(queue + k) % queues.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+    }
+  }
+  if (!job)
+    return false;
+  queuedJobs.fetch_sub(1);
+
+  Batch &batch = *job->batch;
+  try {
+    (*batch.fn)(job->begin, job->end);
+  } catch (...) {
+    std::lock_guard lock(batch.errorMutex);
+    if (!batch.error) {
+      batch.error = std::current_exception();
+    }
+  }
+  if (batch.remaining.fetch_sub(1) == 1) {
+    // The lock orders the notification after the check of the waiter
+    std::lock_guard lock(sleepMutex);
+    batchDone.notify_all();
+  }
+  return true;
+}
+
+void JobSystem::workerLoop(std::size_t queue) {
+  while (true) {
+    if (runJob(queue))
+      continue;
+    std::unique_lock lock(sleepMutex);
+    wakeUp.wait(lock, [&] { return stopping || queuedJobs.load() > 0; });
+    if (stopping)
+      return;
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef JOB_SYSTEM_C
+#define JOB_SYSTEM_C
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool.
+ * Every thread owns a queue of jobs: it pops the most recent ones from
+ * the back of its queue and, once it's empty, steals the oldest ones from
+ * the front of the others. The thread that calls parallelFor works on the
+ * jobs too, instead of sleeping until they are done.
+ */
+class JobSystem {
+public:
+  using RangeFn = std::function<void(std::size_t begin, std::size_t end)>;
+
+  /**
+   * @param threadCount - threads running the jobs, the caller of
+   * parallelFor included. 1 runs everything on the calling thread
+   */
+  explicit JobSystem(
+      std::size_t threadCount = std::thread::hardware_concurrency());
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  std::size_t getThreadCount() const { return queues.size(); }
+  /**
+   * Split [0, n) in chunks of chunkSize elements and call fn(begin, end)
+   * on each of them in parallel, returns when all of them are done.
+   * Which thread runs a chunk is not deterministic: fn must not depend on
+   * it. The first exception thrown by fn is rethrown here, once all the
+   * chunks are done.
+   */
+  void parallelFor(std::size_t n, std::size_t chunkSize, const RangeFn &fn);
+
+private:
+  // Chunks of a parallelFor call
+  struct Batch {
+    Batch(const RangeFn *fn, std::size_t chunks)
+        : fn{fn}, remaining{chunks} {};
+
+    const RangeFn *fn;
+    std::atomic<std::size_t> remaining;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+  };
+  struct Job {
+    Batch *batch;
+    std::size_t begin, end;
+  };
+  // On its own cache line to avoid false sharing between the threads
+  struct alignas(64) WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  // queues[0] belongs to the callers of parallelFor,
+  // queues[i] to workers[i - 1]
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::vector<std::thread> workers;
+  // Jobs in the queues, the workers sleep when there are none
+  std::atomic<std::size_t> queuedJobs{0};
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  std::condition_variable batchDone;
+  bool stopping = false;
+
+  void workerLoop(std::size_t queue);
+  // Run a job of queue, or one stolen from the others.
+  // Returns false if all the queues are empty
+  bool runJob(std::size_t queue);
+};
+
+#endif // JOB_SYSTEM_C
@@ -3,9 +3,10 @@
 #include <thread>
 
 #include "WindowManager.h"
-#include "buffer/FrameBuffer.h"
-#include "objects/Entity.h"
+#include "jobs/JobSystem.h"
+#include "objects/DeferredRenderer.h"
 #include "objects/EntityManager.h"
+#include "objects/WeightedBlendedOIT.h"
 #include "shaders/post_processing/PostProcessingShader.h"
 #include "objects/Light.h"
 #include "Camera.h"
@@ -55,6 +56,10 @@ std::map<std::string, Model> loadModels() {
 }
 
 int main() {
+#ifdef GL_STATE_VALIDATION
+  // Check the cached GL state against the driver at every change, slow
+  GLState::get().setValidation(true);
+#endif
   // Load models
   auto models = loadModels();
 
@@ -64,37 +69,37 @@ int main() {
   PostProcessingShader postProcessingShader{};
 
   // Build a scene
-  Entity backpack(models.at("backpack"));
-  backpack.setScale(0.3f);
-  std::vector<PointLight> lights;
+  JobSystem jobSystem;
+  EntityManager entityManager{entityShader, lightShader, jobSystem};
+  const std::uint32_t backpackModel =
+      entityManager.addModel(models.at("backpack"));
+  const std::uint32_t cubeModel = entityManager.addModel(models.at("cube"));
+  entityManager.addSolidEntity(backpackModel, Transform{Vec3d(), 0.3f});
   for (int i = 0; i < 10; i++) {
     const float R = 3.0f;
     // Weird way to generate "random" numbers
     // TODO: write a RNG class
     float t = glfwGetTime() * 10000.0f;
     float t2 = (t + 0.1f) * 10000.0f;
-    PointLight light{models.at("cube"), Vec3f{sin(t), cos(t), sin(2.0f * t)}};
-    light.position =
-        Vec3f{cos(t) * sin(t2) * R, sin(t) * sin(t2) * R, R * cos(t2)};
-    light.setScale(0.2f);
-    lights.push_back(std::move(light));
+    PointLight light{Vec3f{sin(t), cos(t), sin(2.0f * t)}};
+    Vec3f position{cos(t) * sin(t2) * R, sin(t) * sin(t2) * R, R * cos(t2)};
+    entityManager.addPointLight(cubeModel, std::move(light),
+                                Transform{position.cast<double>(), 0.2f});
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
   DirectionalLight dirLight{Vec3f(0.0f, 0.0f, 1.0f), Vec3f(0.1f, 0.1f, 0.1f)};
-
-  EntityManager entityManager{entityShader, lightShader};
-  entityManager.addSolidEntity(&backpack);
-  for (auto &light : lights) {
-    entityManager.addPointLight(&light);
-  }
   entityManager.setDirectionalLight(&dirLight);
 
-  Camera camera{45, Vec3f{0.0f, 0.0f, 3.0f}};
+  Camera camera{45, Vec3d{0.0, 0.0, 3.0}};
 
-  // Create the post-processing variables
-  FrameBuffer postProcessingFBO{globalWindowManager->screenWidth,
-                                globalWindowManager->screenHeight};
-  Entity postProcessingTarget(models.at("rectangle"));
+  // The deferred renderer owns the render target, post-processed after
+  DeferredRenderer deferredRenderer{globalWindowManager->screenWidth,
+                                    globalWindowManager->screenHeight};
+  entityManager.setDeferredRenderer(&deferredRenderer);
+  WeightedBlendedOIT weightedBlendedOIT{globalWindowManager->screenWidth,
+                                        globalWindowManager->screenHeight};
+  entityManager.setWeightedBlendedOIT(&weightedBlendedOIT);
+  const Model &postProcessingTarget = models.at("rectangle");
 
   globalWindowManager->disableMouseCursor();
   float deltaTime;
@@ -115,21 +120,17 @@ int main() {
     entityManager.update(deltaTime);
 
     // render
-    glDisable(GL_FRAMEBUFFER_SRGB);
-    postProcessingFBO.bind();
-    glEnable(GL_DEPTH_TEST);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    GLState::get().disable(GL_FRAMEBUFFER_SRGB);
     entityManager.render(camera);
 
     // post processing
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDisable(GL_DEPTH_TEST);
+    GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::get().disable(GL_DEPTH_TEST);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
     postProcessingShader.use();
-    glActiveTexture(GL_TEXTURE0);
-    postProcessingFBO.bindColor();
+    GLState::get().activeTexture(0);
+    deferredRenderer.bindLitColor();
     postProcessingShader.setPostProcessing(0);
     postProcessingTarget.render(postProcessingShader);
     globalWindowManager->swapBuffers();
@@ -0,0 +1,42 @@
+#ifndef ALIGNED_ALLOCATOR_C
+#define ALIGNED_ALLOCATOR_C
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Minimal allocator returning memory aligned to Alignment bytes,
+ * so that SIMD kernels can use full-width aligned loads and stores.
+ */
+template <typename T, std::size_t Alignment> class AlignedAllocator {
+  static_assert(Alignment >= alignof(T));
+
+public:
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {};
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+  }
+  void deallocate(T *p, std::size_t n) noexcept {
+    ::operator delete(p, n * sizeof(T), std::align_val_t{Alignment});
+  }
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept {
+    return true;
+  }
+};
+
+// 32 bytes by default: enough for AVX2 registers
+template <typename T, std::size_t Alignment = 32>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
+
+#endif // ALIGNED_ALLOCATOR_C
@@ -0,0 +1,142 @@
+#ifndef CONSTEXPR_MATH_C
+#define CONSTEXPR_MATH_C
+
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+// sqrt, sin, cos, tan and acos usable in constant expressions.
+// At runtime they simply forward to <cmath>, so nothing changes for the
+// code that isn't evaluated at compile time. The compile time versions work
+// in double precision and are accurate to the last bit of a float in
+// practice, but they are not guaranteed to be bit-identical to libm.
+namespace constmath {
+namespace detail {
+constexpr double sqrtNewton(double x) {
+  double curr = x > 1.0 ? x : 1.0;
+  double prev = 0.0;
+  while (curr != prev) {
+    prev = curr;
+    curr = 0.5 * (curr + x / curr);
+  }
+  return curr;
+}
+
+// Reduces x to [-pi, pi]
+constexpr double reduceAngle(double x) {
+  constexpr double twoPi = 2.0 * std::numbers::pi;
+  double k = static_cast<double>(static_cast<long long>(x / twoPi));
+  x -= k * twoPi;
+  if (x > std::numbers::pi)
+    x -= twoPi;
+  if (x < -std::numbers::pi)
+    x += twoPi;
+  return x;
+}
+
+// Taylor series, on [-pi, pi] 30 terms are far beyond double precision
+constexpr double sinSeries(double x) {
+  x = reduceAngle(x);
+  double term = x;
+  double res = x;
+  for (int n = 1; n < 30; n++) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    res += term;
+  }
+  return res;
+}
+
+constexpr double cosSeries(double x) {
+  x = reduceAngle(x);
+  double term = 1.0;
+  double res = 1.0;
+  for (int n = 1; n < 30; n++) {
+    term *= -x * x / ((2 * n - 1) * (2 * n));
+    res += term;
+  }
+  return res;
+}
+
+// Taylor series of atan for x >= 0. Reduced to [0, 1] by
+// atan(x) = pi / 2 - atan(1 / x), then halved with
+// atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2))) until the series converges
+// in a few terms
+constexpr double atanSeries(double x) {
+  const bool inverted = x > 1.0;
+  if (inverted)
+    x = 1.0 / x;
+  int halvings = 0;
+  while (x > 0.125) {
+    x /= 1.0 + sqrtNewton(1.0 + x * x);
+    halvings++;
+  }
+  double power = x;
+  double res = x;
+  for (int n = 1; n < 30; n++) {
+    power *= -x * x;
+    res += power / (2 * n + 1);
+  }
+  for (int i = 0; i < halvings; i++) {
+    res *= 2.0;
+  }
+  return inverted ? std::numbers::pi / 2.0 - res : res;
+}
+
+// acos(x) = 2 * atan(sqrt((1 - x) / (1 + x))), x in [-1, 1]
+constexpr double acosSeries(double x) {
+  if (x <= -1.0)
+    return std::numbers::pi;
+  if (x >= 1.0)
+    return 0.0;
+  return 2.0 * atanSeries(sqrtNewton((1.0 - x) / (1.0 + x)));
+}
+} // namespace detail
+
+template <typename T> constexpr T sqrt(T x) {
+  if consteval {
+    if (x < 0 || x != x)
+      return std::numeric_limits<T>::quiet_NaN();
+    if (x == 0 || x == std::numeric_limits<T>::infinity())
+      return x;
+    return static_cast<T>(detail::sqrtNewton(x));
+  } else {
+    return std::sqrt(x);
+  }
+}
+
+template <typename T> constexpr T sin(T x) {
+  if consteval {
+    return static_cast<T>(detail::sinSeries(x));
+  } else {
+    return std::sin(x);
+  }
+}
+
+template <typename T> constexpr T cos(T x) {
+  if consteval {
+    return static_cast<T>(detail::cosSeries(x));
+  } else {
+    return std::cos(x);
+  }
+}
+
+template <typename T> constexpr T tan(T x) {
+  if consteval {
+    return static_cast<T>(detail::sinSeries(x) / detail::cosSeries(x));
+  } else {
+    return std::tan(x);
+  }
+}
+
+template <typename T> constexpr T acos(T x) {
+  if consteval {
+    if (!(x >= -1 && x <= 1))
+      return std::numeric_limits<T>::quiet_NaN();
+    return static_cast<T>(detail::acosSeries(x));
+  } else {
+    return std::acos(x);
+  }
+}
+} // namespace constmath
+
+#endif // CONSTEXPR_MATH_C
@@ -0,0 +1,44 @@
+#include "Frustum.h"
+
+#include "MatrixSimd.h"
+
+void SphereBatch::clear() {
+  for (auto *v : {&cx, &cy, &cz, &radius}) {
+    v->clear();
+  }
+}
+
+void SphereBatch::reserve(std::size_t n) {
+  for (auto *v : {&cx, &cy, &cz, &radius}) {
+    v->reserve(n);
+  }
+}
+
+void SphereBatch::resize(std::size_t n) {
+  for (auto *v : {&cx, &cy, &cz, &radius}) {
+    v->resize(n);
+  }
+}
+
+void SphereBatch::push_back(const Vec3f &center, float radius) {
+  cx.push_back(center(0));
+  cy.push_back(center(1));
+  cz.push_back(center(2));
+  this->radius.push_back(radius);
+}
+
+void SphereBatch::set(std::size_t i, const Vec3f &center, float radius) {
+  cx[i] = center(0);
+  cy[i] = center(1);
+  cz[i] = center(2);
+  this->radius[i] = radius;
+}
+
+std::span<const std::uint32_t> SphereBatch::cull(const Frustum &frustum) {
+  const std::size_t n = size();
+  visible.resize(n);
+  simd::SphereSoA soa{cx.data(), cy.data(), cz.data(), radius.data(), n};
+  std::size_t count = simd::kernels().cullSpheres(frustum.getPlanes().data(),
+                                                  soa, visible.data());
+  return std::span<const std::uint32_t>(visible.data(), count);
+}
@@ -0,0 +1,91 @@
+#ifndef FRUSTUM_C
+#define FRUSTUM_C
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "ConstexprMath.h"
+#include "Matrix.h"
+
+/**
+ * View frustum as 6 planes (a, b, c, d) with normals pointing inside:
+ * a point p is inside the frustum iff a*p.x + b*p.y + c*p.z + d >= 0 for
+ * every plane.
+ */
+class Frustum {
+public:
+  /**
+   * Extract the planes from a projection * view matrix, see
+   * https://www.gribb.com/files/Gribb-Hartmann.pdf
+   * Planes are in world coordinates, with normalized normals so that
+   * plane equations give the signed distance from the plane.
+   */
+  constexpr explicit Frustum(const Mat4f &pvMatrix);
+  constexpr const std::array<float, 24> &getPlanes() const { return planes; }
+  constexpr bool intersectsSphere(const Vec3f &center, float radius) const;
+
+private:
+  // planes[4 * p, 4 * p + 3] = (a, b, c, d) of plane p, in the order
+  // left, right, bottom, top, near, far
+  std::array<float, 24> planes{};
+};
+
+constexpr Frustum::Frustum(const Mat4f &pvMatrix) {
+  // Clip space is -w <= x, y, z <= w, for example
+  // left plane: x >= -w, (row3 + row0) * p >= 0.
+  for (int p = 0; p < 6; p++) {
+    const int row = p / 2;
+    const float sign = p % 2 == 0 ? 1.0f : -1.0f;
+    for (int j = 0; j < 4; j++) {
+      planes[4 * p + j] = pvMatrix(3, j) + sign * pvMatrix(row, j);
+    }
+    const float norm = constmath::sqrt(planes[4 * p] * planes[4 * p] +
+                                       planes[4 * p + 1] * planes[4 * p + 1] +
+                                       planes[4 * p + 2] * planes[4 * p + 2]);
+    for (int j = 0; j < 4; j++) {
+      planes[4 * p + j] /= norm;
+    }
+  }
+}
+
+constexpr bool Frustum::intersectsSphere(const Vec3f &center,
+                                         float radius) const {
+  for (int p = 0; p < 6; p++) {
+    const float *plane = planes.data() + 4 * p;
+    float dist = plane[0] * center(0) + plane[1] * center(1);
+    dist = dist + plane[2] * center(2);
+    dist = dist + plane[3];
+    if (!(dist >= -radius))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Structure of arrays of bounding spheres, culled against a frustum
+ * 4 or 8 at a time.
+ */
+class SphereBatch {
+public:
+  void clear();
+  void reserve(std::size_t n);
+  void resize(std::size_t n);
+  std::size_t size() const { return cx.size(); }
+  void push_back(const Vec3f &center, float radius);
+  void set(std::size_t i, const Vec3f &center, float radius);
+  /**
+   * Indices, in ascending order, of the spheres that intersect the frustum.
+   * The span is valid until the next call.
+   */
+  std::span<const std::uint32_t> cull(const Frustum &frustum);
+
+private:
+  AlignedVector<float> cx, cy, cz;
+  AlignedVector<float> radius;
+  std::vector<std::uint32_t> visible;
+};
+
+#endif // FRUSTUM_C
@@ -1,12 +1,60 @@
 #ifndef MATRIX_C
 #define MATRIX_C
 
+#include <concepts>
+#include <functional>
 #include <ostream>
 #include <span>
 #include <type_traits>
 #include <array>
 
 #include "math.h"
+#include "ConstexprMath.h"
+#include "MatrixSimd.h"
+
+// Lazy element-wise expressions (+, -, unary -, scalar *).
+// Operators build a tree of nodes instead of Matrix temporaries, the tree is
+// evaluated element by element in a single loop only when it's assigned to a
+// Matrix. This way an expression like a + b * c - d (c scalar) doesn't
+// allocate any intermediate result.
+// Matrix-matrix products are not element-wise and are still evaluated eagerly.
+namespace expr {
+// Base of every expression node (Matrix is a leaf, not a node)
+struct Node {};
+
+template <typename E>
+constexpr bool isNode = std::is_base_of_v<Node, std::remove_cvref_t<E>>;
+
+// Anything that can be indexed element-wise in storage order:
+// Matrix, Vector and expression nodes.
+template <typename E>
+concept MatrixExpression = requires(const E &e, std::size_t i) {
+  typename E::value_type;
+  { E::rows } -> std::convertible_to<std::size_t>;
+  { E::cols } -> std::convertible_to<std::size_t>;
+  { e[i] } -> std::convertible_to<typename E::value_type>;
+};
+
+template <typename E1, typename E2>
+concept SameShape =
+    E1::rows == E2::rows && E1::cols == E2::cols &&
+    std::is_same_v<typename E1::value_type, typename E2::value_type>;
+
+// How a node keeps its operands: lvalue matrices by reference, nodes and
+// temporary matrices by value, so that operands never dangle.
+template <typename E>
+using Stored = std::conditional_t<std::is_lvalue_reference_v<E> && !isNode<E>,
+                                  const std::remove_cvref_t<E> &,
+                                  std::remove_cvref_t<E>>;
+} // namespace expr
+
+// Storage alignment: 16 bytes (an SSE register, a std140 vec4) when the
+// size is a multiple of it, like Mat4f and Vec4f. Arrays of these matrices
+// are then contiguous, aligned and ready to be uploaded to the GPU as they
+// are.
+template <typename T, std::size_t Size>
+inline constexpr std::size_t storageAlignment =
+    (Size * sizeof(T)) % 16 == 0 ? 16 : alignof(T);
 
 // N number of rows, M number of columns
 template <typename T, std::size_t N, std::size_t M> class Matrix {
@@ -17,62 +65,118 @@ protected:
   // had as bottleneck the heap allocation/deallocation.
   // At the same time with std::array we lose the std::move property
   // but profiling is showing that it's not a problem.
-  std::array<T, N * M> matData{};
+  alignas(storageAlignment<T, N * M>) std::array<T, N * M> matData{};
 
 private:
-  Matrix(const Matrix<T, N, M> &mat) : matData{mat.matData} {};
+  constexpr Matrix(const Matrix<T, N, M> &mat) : matData{mat.matData} {};
 
 public:
+  using value_type = T;
+  static constexpr std::size_t rows = N;
+  static constexpr std::size_t cols = M;
+
   Matrix() = default;
   // TODO: Once we make sure that std::array<>
   // doesn't give any problem with stack size,
   // remove all std::vector remains (move constructor, .clone, etc...)
-  Matrix(Matrix<T, N, M> &&mat) : matData{std::move(mat.matData)} {};
-  Matrix<T, N, M> &operator=(Matrix<T, N, M> mat);
-  Matrix<T, N, M> clone() const;
-
-  inline T &operator()(std::size_t x, std::size_t y);
-  inline const T &operator()(std::size_t x, std::size_t y) const;
+  constexpr Matrix(Matrix<T, N, M> &&mat)
+      : matData{std::move(mat.matData)} {};
+  // Evaluates an expression in a single pass
+  template <expr::MatrixExpression E>
+    requires expr::isNode<E> && expr::SameShape<Matrix<T, N, M>, E>
+  constexpr Matrix(const E &e);
+  constexpr Matrix<T, N, M> &operator=(Matrix<T, N, M> mat);
+  template <expr::MatrixExpression E>
+    requires expr::isNode<E> && expr::SameShape<Matrix<T, N, M>, E>
+  constexpr Matrix<T, N, M> &operator=(const E &e);
+  constexpr Matrix<T, N, M> clone() const;
+  // Element-wise conversion to another scalar type
+  template <typename U> constexpr Matrix<U, N, M> cast() const;
+
+  constexpr T &operator()(std::size_t x, std::size_t y);
+  constexpr const T &operator()(std::size_t x, std::size_t y) const;
+  // Element in storage order, used to evaluate expressions
+  constexpr const T &operator[](std::size_t i) const { return matData[i]; }
 
   // Basic operations
   // 1) matrix-scalar operations
-  Matrix<T, N, M> &operator*=(const T &c1);
-  Matrix<T, N, M> &operator/=(const T &c1);
+  constexpr Matrix<T, N, M> &operator*=(const T &c1);
+  constexpr Matrix<T, N, M> &operator/=(const T &c1);
 
   // 2) matrix-matrix operations
-  Matrix<T, N, M> &operator+=(const Matrix<T, N, M> &m1);
-  Matrix<T, N, M> &operator-=(const Matrix<T, N, M> &m1);
+  template <expr::MatrixExpression E>
+    requires expr::SameShape<Matrix<T, N, M>, E>
+  constexpr Matrix<T, N, M> &operator+=(const E &e);
+  template <expr::MatrixExpression E>
+    requires expr::SameShape<Matrix<T, N, M>, E>
+  constexpr Matrix<T, N, M> &operator-=(const E &e);
 
   // 3) unary operators
-  Matrix<T, N, M> operator-() const;
-  T norm() const;
-  T norm2() const;
+  constexpr T norm() const;
+  constexpr T norm2() const;
+  // Element-wise comparison
+  constexpr bool operator==(const Matrix<T, N, M> &m) const = default;
 
-  std::span<const T, N * M> data() const {
+  constexpr std::span<const T, N * M> data() const {
     return std::span<const T, N * M>(this->matData.data(), N * M);
   }
+  constexpr std::span<T, N * M> data() {
+    return std::span<T, N * M>(this->matData.data(), N * M);
+  }
 };
 
+template <typename T, std::size_t N, std::size_t M>
+template <typename U>
+constexpr Matrix<U, N, M> Matrix<T, N, M>::cast() const {
+  Matrix<U, N, M> res;
+  for (std::size_t i = 0; i < N * M; i++) {
+    res.data()[i] = static_cast<U>(matData[i]);
+  }
+  return res;
+}
+
 // x column y row
 template <typename T, std::size_t N, std::size_t M>
-T &Matrix<T, N, M>::operator()(std::size_t x, std::size_t y) {
+constexpr T &Matrix<T, N, M>::operator()(std::size_t x, std::size_t y) {
   return matData[x + y * N];
 }
 
 // x column y row
 template <typename T, std::size_t N, std::size_t M>
-const T &Matrix<T, N, M>::operator()(std::size_t x, std::size_t y) const {
+constexpr const T &Matrix<T, N, M>::operator()(std::size_t x,
+                                                std::size_t y) const {
   return matData[x + y * N];
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> &Matrix<T, N, M>::operator=(Matrix<T, N, M> mat) {
+template <expr::MatrixExpression E>
+  requires expr::isNode<E> && expr::SameShape<Matrix<T, N, M>, E>
+constexpr Matrix<T, N, M>::Matrix(const E &e) {
+  for (size_t i = 0; i < N * M; i++) {
+    matData[i] = e[i];
+  }
+}
+
+template <typename T, std::size_t N, std::size_t M>
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator=(Matrix<T, N, M> mat) {
   matData = std::move(mat.matData);
   return *this;
 };
 
+// Expressions are element-wise, therefore it's safe to evaluate them
+// directly in place even when *this appears as an operand.
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> Matrix<T, N, M>::clone() const {
+template <expr::MatrixExpression E>
+  requires expr::isNode<E> && expr::SameShape<Matrix<T, N, M>, E>
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator=(const E &e) {
+  for (size_t i = 0; i < N * M; i++) {
+    matData[i] = e[i];
+  }
+  return *this;
+}
+
+template <typename T, std::size_t N, std::size_t M>
+constexpr Matrix<T, N, M> Matrix<T, N, M>::clone() const {
   return Matrix<T, N, M>{*this};
 };
 
@@ -88,50 +192,32 @@ std::ostream &operator<<(std::ostream &o, const Matrix<T, N, M> &m1) {
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> Matrix<T, N, M>::operator-() const {
-  Matrix<T, N, M> res = this->clone();
-  for (T &el : res.matData) {
-    el = -el;
-  }
-  return res;
-}
-
-template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> &Matrix<T, N, M>::operator+=(const Matrix<T, N, M> &m1) {
+template <expr::MatrixExpression E>
+  requires expr::SameShape<Matrix<T, N, M>, E>
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator+=(const E &e) {
   for (size_t i = 0; i < N * M; i++) {
-    matData[i] += m1.matData[i];
+    matData[i] += e[i];
   }
   return *this;
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> &Matrix<T, N, M>::operator-=(const Matrix<T, N, M> &m1) {
+template <expr::MatrixExpression E>
+  requires expr::SameShape<Matrix<T, N, M>, E>
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator-=(const E &e) {
   for (size_t i = 0; i < N * M; i++) {
-    matData[i] -= m1.matData[i];
+    matData[i] -= e[i];
   }
   return *this;
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> operator+(const Matrix<T, N, M> &m1,
-                          const Matrix<T, N, M> &m2) {
-  Matrix<T, N, M> res = m1.clone();
-  res += m2;
-  return res;
-}
-template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> operator-(const Matrix<T, N, M> &m1,
-                          const Matrix<T, N, M> &m2) {
-  return m1 + (-m2);
+constexpr T Matrix<T, N, M>::norm() const {
+  return constmath::sqrt(norm2());
 }
 
 template <typename T, std::size_t N, std::size_t M>
-T Matrix<T, N, M>::norm() const {
-  return sqrt(norm2());
-}
-
-template <typename T, std::size_t N, std::size_t M>
-T Matrix<T, N, M>::norm2() const {
+constexpr T Matrix<T, N, M>::norm2() const {
   T norm2 = 0;
   for (const T &el : matData) {
     norm2 += el * el;
@@ -140,7 +226,7 @@ T Matrix<T, N, M>::norm2() const {
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> &Matrix<T, N, M>::operator*=(const T &c1) {
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator*=(const T &c1) {
   for (T &el : matData) {
     el *= c1;
   }
@@ -148,25 +234,88 @@ Matrix<T, N, M> &Matrix<T, N, M>::operator*=(const T &c1) {
 }
 
 template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> &Matrix<T, N, M>::operator/=(const T &c1) {
+constexpr Matrix<T, N, M> &Matrix<T, N, M>::operator/=(const T &c1) {
   return (*this) *= (1.0 / c1);
 }
 
-template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> operator*(const Matrix<T, N, M> &m1, const T &c) {
-  Matrix<T, N, M> res = m1.clone();
-  res *= c;
-  return res;
+namespace expr {
+template <typename Op, typename E> class Unary : public Node {
+  Stored<E> e;
+
+public:
+  using value_type = typename std::remove_cvref_t<E>::value_type;
+  static constexpr std::size_t rows = std::remove_cvref_t<E>::rows;
+  static constexpr std::size_t cols = std::remove_cvref_t<E>::cols;
+  constexpr Unary(E &&e) : e{std::forward<E>(e)} {};
+  constexpr value_type operator[](std::size_t i) const { return Op{}(e[i]); }
+};
+
+template <typename Op, typename L, typename R> class Binary : public Node {
+  Stored<L> l;
+  Stored<R> r;
+
+public:
+  using value_type = typename std::remove_cvref_t<L>::value_type;
+  static constexpr std::size_t rows = std::remove_cvref_t<L>::rows;
+  static constexpr std::size_t cols = std::remove_cvref_t<L>::cols;
+  constexpr Binary(L &&l, R &&r)
+      : l{std::forward<L>(l)}, r{std::forward<R>(r)} {};
+  constexpr value_type operator[](std::size_t i) const {
+    return Op{}(l[i], r[i]);
+  }
+};
+
+// Product by a scalar, e[i] * c
+template <typename E> class Scaled : public Node {
+  Stored<E> e;
+  typename std::remove_cvref_t<E>::value_type c;
+
+public:
+  using value_type = typename std::remove_cvref_t<E>::value_type;
+  static constexpr std::size_t rows = std::remove_cvref_t<E>::rows;
+  static constexpr std::size_t cols = std::remove_cvref_t<E>::cols;
+  constexpr Scaled(E &&e, value_type c) : e{std::forward<E>(e)}, c{c} {};
+  constexpr value_type operator[](std::size_t i) const { return e[i] * c; }
+};
+} // namespace expr
+
+template <typename E>
+  requires expr::MatrixExpression<std::remove_cvref_t<E>>
+constexpr expr::Unary<std::negate<>, E> operator-(E &&e) {
+  return {std::forward<E>(e)};
 }
 
-template <typename T, std::size_t N, std::size_t M>
-Matrix<T, N, M> operator*(const T &c, const Matrix<T, N, M> &m1) {
-  return m1 * c;
+template <typename L, typename R>
+  requires expr::MatrixExpression<std::remove_cvref_t<L>> &&
+           expr::SameShape<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+constexpr expr::Binary<std::plus<>, L, R> operator+(L &&l, R &&r) {
+  return {std::forward<L>(l), std::forward<R>(r)};
+}
+
+template <typename L, typename R>
+  requires expr::MatrixExpression<std::remove_cvref_t<L>> &&
+           expr::SameShape<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+constexpr expr::Binary<std::minus<>, L, R> operator-(L &&l, R &&r) {
+  return {std::forward<L>(l), std::forward<R>(r)};
+}
+
+template <typename E>
+  requires expr::MatrixExpression<std::remove_cvref_t<E>>
+constexpr expr::Scaled<E>
+operator*(E &&e, const typename std::remove_cvref_t<E>::value_type &c) {
+  return {std::forward<E>(e), c};
+}
+
+template <typename E>
+  requires expr::MatrixExpression<std::remove_cvref_t<E>>
+constexpr expr::Scaled<E>
+operator*(const typename std::remove_cvref_t<E>::value_type &c, E &&e) {
+  return {std::forward<E>(e), c};
 }
 
 template <typename T, std::size_t N, std::size_t M, std::size_t K>
-Matrix<T, N, K> operator*(const Matrix<T, N, M> &m1,
-                          const Matrix<T, M, K> &m2) {
+constexpr Matrix<T, N, K> operator*(const Matrix<T, N, M> &m1,
+                                    const Matrix<T, M, K> &m2) {
   Matrix<T, N, K> res;
   for (size_t j = 0; j < K; j++) {
     for (size_t k = 0; k < M; k++) {
@@ -180,28 +329,33 @@ Matrix<T, N, K> operator*(const Matrix<T, N, M> &m1,
 
 template <typename T, std::size_t N> class Vector : public Matrix<T, N, 1> {
 public:
-  Vector(Matrix<T, N, 1> &&mat) : Matrix<T, N, 1>{std::move(mat)} {};
+  constexpr Vector(Matrix<T, N, 1> &&mat)
+      : Matrix<T, N, 1>{std::move(mat)} {};
+  template <expr::MatrixExpression E>
+    requires expr::isNode<E> && expr::SameShape<Matrix<T, N, 1>, E>
+  constexpr Vector(const E &e) : Matrix<T, N, 1>{e} {};
+  using Matrix<T, N, 1>::operator=;
   template <typename... U>
     requires(sizeof...(U) == N * 1) &&
             (std::is_same_v<T, std::decay_t<U>> && ...)
-  Vector(U &&...args) {
+  constexpr Vector(U &&...args) {
     this->matData = {std::forward<U>(args)...};
   };
   Vector() = default;
-  T &operator()(std::size_t x);
-  const T &operator()(std::size_t x) const;
+  constexpr T &operator()(std::size_t x);
+  constexpr const T &operator()(std::size_t x) const;
 
   T &operator()(std::size_t x, std::size_t y) = delete;
   const T &operator()(std::size_t x, std::size_t y) const = delete;
 };
 
 template <typename T, std::size_t N>
-T &Vector<T, N>::operator()(std::size_t x) {
+constexpr T &Vector<T, N>::operator()(std::size_t x) {
   return Matrix<T, N, 1>::operator()(x, 0);
 }
 
 template <typename T, std::size_t N>
-const T &Vector<T, N>::operator()(std::size_t x) const {
+constexpr const T &Vector<T, N>::operator()(std::size_t x) const {
   return Matrix<T, N, 1>::operator()(x, 0);
 }
 
@@ -210,5 +364,39 @@ typedef Matrix<float, 4, 4> Mat4f;
 typedef Matrix<float, 3, 3> Mat3f;
 typedef Vector<float, 3> Vec3f;
 typedef Vector<float, 4> Vec4f;
+// World positions, see mat::relativePosition
+typedef Vector<double, 3> Vec3d;
+
+static_assert(alignof(Mat4f) == 16 && sizeof(Mat4f) == 16 * sizeof(float));
+static_assert(alignof(Vec4f) == 16 && sizeof(Vec4f) == 4 * sizeof(float));
+static_assert(sizeof(Vec3f) == 3 * sizeof(float),
+              "Vec3f is tightly packed, see PaddedVec3f for std140");
+
+// Overloads of the generic product for the hot 4x4 cases,
+// dispatched to the SIMD kernels supported by the CPU
+constexpr Mat4f operator*(const Mat4f &m1, const Mat4f &m2) {
+  if consteval {
+    // Generic template
+    return operator*<float, 4, 4, 4>(m1, m2);
+  } else {
+    Mat4f res;
+    simd::kernels().mat4Mul(m1.data().data(), m2.data().data(),
+                            res.data().data());
+    return res;
+  }
+}
+
+constexpr Matrix<float, 4, 1> operator*(const Mat4f &m1,
+                                        const Matrix<float, 4, 1> &v) {
+  if consteval {
+    // Generic template
+    return operator*<float, 4, 4, 1>(m1, v);
+  } else {
+    Matrix<float, 4, 1> res;
+    simd::kernels().mat4MulVec(m1.data().data(), v.data().data(),
+                               res.data().data());
+    return res;
+  }
+}
 
 #endif // MATRIX_C
\ No newline at end of file
@@ -0,0 +1,666 @@
+#include "MatrixSimd.h"
+
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_SIMD_X86
+#endif
+
+namespace simd {
+
+// Scalar fallback, same loops of the generic Matrix implementation
+static void mat4MulScalar(const float *a, const float *b, float *res) {
+  for (int i = 0; i < 16; i++) {
+    res[i] = 0.0f;
+  }
+  for (int j = 0; j < 4; j++) {
+    for (int k = 0; k < 4; k++) {
+      for (int i = 0; i < 4; i++) {
+        res[i + j * 4] += a[i + k * 4] * b[k + j * 4];
+      }
+    }
+  }
+}
+
+static void mat4MulVecScalar(const float *m, const float *v, float *res) {
+  for (int i = 0; i < 4; i++) {
+    res[i] = 0.0f;
+  }
+  for (int k = 0; k < 4; k++) {
+    for (int i = 0; i < 4; i++) {
+      res[i] += m[i + k * 4] * v[k];
+    }
+  }
+}
+
+static void mat4MultByDiagonalScalar(float *m, const float *d) {
+  reference::mat4MultByDiagonal(m, d);
+}
+
+// Same operations, in the same order, of mat::modelMatrix:
+// entries of Quaternion::toMat4 scaled by the diagonal scaling matrix.
+static void buildModelMatrixScalar(const TransformSoA &in, std::size_t i,
+                                   float *m) {
+  const float w = in.qw[i], x = in.qx[i], y = in.qy[i], z = in.qz[i];
+  const float s = in.scale[i];
+  const float xx = x * x, yy = y * y, zz = z * z;
+  const float xy = x * y, xz = x * z, yz = y * z;
+  const float wx = w * x, wy = w * y, wz = w * z;
+  m[0] = s * (1.0f - 2.0f * (yy + zz));
+  m[1] = s * (2.0f * (xy + wz));
+  m[2] = s * (2.0f * (xz - wy));
+  m[3] = 0.0f;
+  m[4] = s * (2.0f * (xy - wz));
+  m[5] = s * (1.0f - 2.0f * (xx + zz));
+  m[6] = s * (2.0f * (yz + wx));
+  m[7] = 0.0f;
+  m[8] = s * (2.0f * (xz + wy));
+  m[9] = s * (2.0f * (yz - wx));
+  m[10] = s * (1.0f - 2.0f * (xx + yy));
+  m[11] = 0.0f;
+  m[12] = in.px[i];
+  m[13] = in.py[i];
+  m[14] = in.pz[i];
+  m[15] = 1.0f;
+}
+
+static void buildModelMatricesScalar(const TransformSoA &in, float *out) {
+  for (std::size_t i = 0; i < in.n; i++) {
+    buildModelMatrixScalar(in, i, out + 16 * i);
+  }
+}
+
+static void mat4InverseScalar(const float *m, float *res) {
+  reference::mat4Inverse(m, res);
+}
+
+static void mat4AffineInverseScalar(const float *m, float *res) {
+  reference::mat4AffineInverse(m, res);
+}
+
+// Signed distances are accumulated as ((a*x + b*y) + c*z) + d by every
+// implementation. A NaN distance culls the sphere, like a false comparison
+// in the SIMD versions.
+static bool sphereVisibleScalar(const float *planes, const SphereSoA &in,
+                                std::size_t i) {
+  for (int p = 0; p < 6; p++) {
+    const float *plane = planes + 4 * p;
+    float dist = plane[0] * in.cx[i] + plane[1] * in.cy[i];
+    dist = dist + plane[2] * in.cz[i];
+    dist = dist + plane[3];
+    if (!(dist >= -in.radius[i]))
+      return false;
+  }
+  return true;
+}
+
+static std::size_t cullSpheresScalar(const float *planes, const SphereSoA &in,
+                                     std::uint32_t *visible) {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < in.n; i++) {
+    if (sphereVisibleScalar(planes, in, i))
+      visible[count++] = i;
+  }
+  return count;
+}
+
+static void sincosScalar(const float *x, std::size_t n, float *s, float *c) {
+  for (std::size_t i = 0; i < n; i++) {
+    reference::sincos(x[i], s[i], c[i]);
+  }
+}
+
+#ifdef MATRIX_SIMD_X86
+// Accumulation starts from +0.0f like the scalar loops,
+// otherwise -0.0f products would not be bit-identical.
+// Only mul + add are used: an FMA would round differently.
+__attribute__((target("sse4.1"))) static void
+mat4MulSse(const float *a, const float *b, float *res) {
+  __m128 a0 = _mm_loadu_ps(a);
+  __m128 a1 = _mm_loadu_ps(a + 4);
+  __m128 a2 = _mm_loadu_ps(a + 8);
+  __m128 a3 = _mm_loadu_ps(a + 12);
+  for (int j = 0; j < 4; j++) {
+    const float *bj = b + j * 4;
+    __m128 r = _mm_setzero_ps();
+    r = _mm_add_ps(r, _mm_mul_ps(a0, _mm_set1_ps(bj[0])));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bj[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bj[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bj[3])));
+    _mm_storeu_ps(res + j * 4, r);
+  }
+}
+
+__attribute__((target("sse4.1"))) static void
+mat4MulVecSse(const float *m, const float *v, float *res) {
+  __m128 r = _mm_setzero_ps();
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0])));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+  _mm_storeu_ps(res, r);
+}
+
+__attribute__((target("sse4.1"))) static void
+mat4MultByDiagonalSse(float *m, const float *d) {
+  for (int j = 0; j < 4; j++) {
+    __m128 col = _mm_loadu_ps(m + j * 4);
+    _mm_storeu_ps(m + j * 4, _mm_mul_ps(col, _mm_set1_ps(d[j])));
+  }
+}
+
+// Two columns of the result per iteration: both 128 bit lanes hold
+// the same column of a, while the in-lane permutation broadcasts
+// b(k, j) in the low lane and b(k, j + 1) in the high lane.
+__attribute__((target("avx2"))) static void
+mat4MulAvx2(const float *a, const float *b, float *res) {
+  __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a));
+  __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 4));
+  __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 8));
+  __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 12));
+  for (int j = 0; j < 4; j += 2) {
+    __m256 bj = _mm256_loadu_ps(b + j * 4);
+    __m256 r = _mm256_setzero_ps();
+    r = _mm256_add_ps(r, _mm256_mul_ps(a0, _mm256_permute_ps(bj, 0x00)));
+    r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(bj, 0x55)));
+    r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(bj, 0xAA)));
+    r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(bj, 0xFF)));
+    _mm256_storeu_ps(res + j * 4, r);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+mat4MultByDiagonalAvx2(float *m, const float *d) {
+  for (int j = 0; j < 4; j += 2) {
+    __m256 scale = _mm256_set_m128(_mm_set1_ps(d[j + 1]), _mm_set1_ps(d[j]));
+    __m256 cols = _mm256_loadu_ps(m + j * 4);
+    _mm256_storeu_ps(m + j * 4, _mm256_mul_ps(cols, scale));
+  }
+}
+
+// Diagonal, s * (1 - 2 * (a + b)), and off-diagonal, s * (2 * a),
+// entries of the scaled rotation matrix
+__attribute__((target("sse4.1"))) static inline __m128
+rotDiagSse(__m128 s, __m128 a, __m128 b) {
+  __m128 twice = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_add_ps(a, b));
+  return _mm_mul_ps(s, _mm_sub_ps(_mm_set1_ps(1.0f), twice));
+}
+
+__attribute__((target("sse4.1"))) static inline __m128 rotOffSse(__m128 s,
+                                                                 __m128 a) {
+  return _mm_mul_ps(s, _mm_mul_ps(_mm_set1_ps(2.0f), a));
+}
+
+__attribute__((target("avx2"))) static inline __m256
+rotDiagAvx2(__m256 s, __m256 a, __m256 b) {
+  __m256 twice = _mm256_mul_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(a, b));
+  return _mm256_mul_ps(s, _mm256_sub_ps(_mm256_set1_ps(1.0f), twice));
+}
+
+__attribute__((target("avx2"))) static inline __m256 rotOffAvx2(__m256 s,
+                                                                __m256 a) {
+  return _mm256_mul_ps(s, _mm256_mul_ps(_mm256_set1_ps(2.0f), a));
+}
+
+// Entities are processed 4 at a time: every register holds the same
+// matrix element of 4 different entities, then 4x4 transpositions turn
+// them into the columns of each matrix.
+__attribute__((target("sse4.1"))) static void
+buildModelMatricesSse(const TransformSoA &in, float *out) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  std::size_t i = 0;
+  for (; i + 4 <= in.n; i += 4) {
+    __m128 w = _mm_loadu_ps(in.qw + i);
+    __m128 x = _mm_loadu_ps(in.qx + i);
+    __m128 y = _mm_loadu_ps(in.qy + i);
+    __m128 z = _mm_loadu_ps(in.qz + i);
+    __m128 s = _mm_loadu_ps(in.scale + i);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    __m128 c0[4] = {rotDiagSse(s, yy, zz), rotOffSse(s, _mm_add_ps(xy, wz)),
+                    rotOffSse(s, _mm_sub_ps(xz, wy)), zero};
+    __m128 c1[4] = {rotOffSse(s, _mm_sub_ps(xy, wz)), rotDiagSse(s, xx, zz),
+                    rotOffSse(s, _mm_add_ps(yz, wx)), zero};
+    __m128 c2[4] = {rotOffSse(s, _mm_add_ps(xz, wy)),
+                    rotOffSse(s, _mm_sub_ps(yz, wx)), rotDiagSse(s, xx, yy),
+                    zero};
+    __m128 c3[4] = {_mm_loadu_ps(in.px + i), _mm_loadu_ps(in.py + i),
+                    _mm_loadu_ps(in.pz + i), one};
+
+    __m128 *columns[4] = {c0, c1, c2, c3};
+    for (int col = 0; col < 4; col++) {
+      __m128 *c = columns[col];
+      _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+      for (int e = 0; e < 4; e++) {
+        _mm_storeu_ps(out + 16 * (i + e) + 4 * col, c[e]);
+      }
+    }
+  }
+  for (; i < in.n; i++) {
+    buildModelMatrixScalar(in, i, out + 16 * i);
+  }
+}
+
+// Same scheme of the SSE version with 8 entities at a time. The transposition
+// works independently on the two 128 bit lanes, lane 0 holds entities 0-3 and
+// lane 1 entities 4-7.
+__attribute__((target("avx2"))) static void
+buildModelMatricesAvx2(const TransformSoA &in, float *out) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= in.n; i += 8) {
+    __m256 w = _mm256_loadu_ps(in.qw + i);
+    __m256 x = _mm256_loadu_ps(in.qx + i);
+    __m256 y = _mm256_loadu_ps(in.qy + i);
+    __m256 z = _mm256_loadu_ps(in.qz + i);
+    __m256 s = _mm256_loadu_ps(in.scale + i);
+
+    __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y),
+           zz = _mm256_mul_ps(z, z);
+    __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z),
+           yz = _mm256_mul_ps(y, z);
+    __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y),
+           wz = _mm256_mul_ps(w, z);
+
+    __m256 c0[4] = {rotDiagAvx2(s, yy, zz),
+                    rotOffAvx2(s, _mm256_add_ps(xy, wz)),
+                    rotOffAvx2(s, _mm256_sub_ps(xz, wy)), zero};
+    __m256 c1[4] = {rotOffAvx2(s, _mm256_sub_ps(xy, wz)),
+                    rotDiagAvx2(s, xx, zz),
+                    rotOffAvx2(s, _mm256_add_ps(yz, wx)), zero};
+    __m256 c2[4] = {rotOffAvx2(s, _mm256_add_ps(xz, wy)),
+                    rotOffAvx2(s, _mm256_sub_ps(yz, wx)),
+                    rotDiagAvx2(s, xx, yy), zero};
+    __m256 c3[4] = {_mm256_loadu_ps(in.px + i), _mm256_loadu_ps(in.py + i),
+                    _mm256_loadu_ps(in.pz + i), one};
+
+    __m256 *columns[4] = {c0, c1, c2, c3};
+    for (int col = 0; col < 4; col++) {
+      __m256 *c = columns[col];
+      __m256 t0 = _mm256_unpacklo_ps(c[0], c[1]);
+      __m256 t1 = _mm256_unpackhi_ps(c[0], c[1]);
+      __m256 t2 = _mm256_unpacklo_ps(c[2], c[3]);
+      __m256 t3 = _mm256_unpackhi_ps(c[2], c[3]);
+      __m256 e[4] = {_mm256_shuffle_ps(t0, t2, 0x44),
+                     _mm256_shuffle_ps(t0, t2, 0xEE),
+                     _mm256_shuffle_ps(t1, t3, 0x44),
+                     _mm256_shuffle_ps(t1, t3, 0xEE)};
+      for (int k = 0; k < 4; k++) {
+        _mm_storeu_ps(out + 16 * (i + k) + 4 * col,
+                      _mm256_castps256_ps128(e[k]));
+        _mm_storeu_ps(out + 16 * (i + k + 4) + 4 * col,
+                      _mm256_extractf128_ps(e[k], 1));
+      }
+    }
+  }
+  // The scalar tail isn't VEX encoded: clear the upper halves to avoid
+  // the AVX-SSE transition penalty
+  _mm256_zeroupper();
+  for (; i < in.n; i++) {
+    buildModelMatrixScalar(in, i, out + 16 * i);
+  }
+}
+// 4 spheres at a time, the visibility mask of the lanes is then
+// turned into indices
+__attribute__((target("sse4.1"))) static std::size_t
+cullSpheresSse(const float *planes, const SphereSoA &in,
+               std::uint32_t *visible) {
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  std::size_t count = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= in.n; i += 4) {
+    __m128 x = _mm_loadu_ps(in.cx + i);
+    __m128 y = _mm_loadu_ps(in.cy + i);
+    __m128 z = _mm_loadu_ps(in.cz + i);
+    __m128 minusR = _mm_xor_ps(_mm_loadu_ps(in.radius + i), signBit);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      const float *plane = planes + 4 * p;
+      __m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x),
+                               _mm_mul_ps(_mm_set1_ps(plane[1]), y));
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane[2]), z));
+      dist = _mm_add_ps(dist, _mm_set1_ps(plane[3]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, minusR));
+    }
+    int mask = _mm_movemask_ps(inside);
+    while (mask) {
+      visible[count++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  for (; i < in.n; i++) {
+    if (sphereVisibleScalar(planes, in, i))
+      visible[count++] = i;
+  }
+  return count;
+}
+
+__attribute__((target("avx2"))) static std::size_t
+cullSpheresAvx2(const float *planes, const SphereSoA &in,
+                std::uint32_t *visible) {
+  const __m256 signBit = _mm256_set1_ps(-0.0f);
+  std::size_t count = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= in.n; i += 8) {
+    __m256 x = _mm256_loadu_ps(in.cx + i);
+    __m256 y = _mm256_loadu_ps(in.cy + i);
+    __m256 z = _mm256_loadu_ps(in.cz + i);
+    __m256 minusR = _mm256_xor_ps(_mm256_loadu_ps(in.radius + i), signBit);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      const float *plane = planes + 4 * p;
+      __m256 dist = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), x),
+                                  _mm256_mul_ps(_mm256_set1_ps(plane[1]), y));
+      dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(plane[2]), z));
+      dist = _mm256_add_ps(dist, _mm256_set1_ps(plane[3]));
+      inside =
+          _mm256_and_ps(inside, _mm256_cmp_ps(dist, minusR, _CMP_GE_OQ));
+    }
+    int mask = _mm256_movemask_ps(inside);
+    while (mask) {
+      visible[count++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  _mm256_zeroupper();
+  for (; i < in.n; i++) {
+    if (sphereVisibleScalar(planes, in, i))
+      visible[count++] = i;
+  }
+  return count;
+}
+
+// SSE version of reference::mat4Inverse, same operations in the same order
+__attribute__((target("sse4.1"))) static inline __m128
+mat2MulSse(__m128 a, __m128 b) {
+  return _mm_add_ps(
+      _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+__attribute__((target("sse4.1"))) static inline __m128
+mat2AdjMulSse(__m128 a, __m128 b) {
+  return _mm_sub_ps(
+      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)),
+                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+__attribute__((target("sse4.1"))) static inline __m128
+mat2MulAdjSse(__m128 a, __m128 b) {
+  return _mm_sub_ps(
+      _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                 _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+__attribute__((target("sse4.1"))) static void mat4InverseSse(const float *m,
+                                                            float *res) {
+  __m128 r0 = _mm_loadu_ps(m);
+  __m128 r1 = _mm_loadu_ps(m + 4);
+  __m128 r2 = _mm_loadu_ps(m + 8);
+  __m128 r3 = _mm_loadu_ps(m + 12);
+  __m128 a = _mm_movelh_ps(r0, r1);
+  __m128 b = _mm_movehl_ps(r1, r0);
+  __m128 c = _mm_movelh_ps(r2, r3);
+  __m128 d = _mm_movehl_ps(r3, r2);
+
+  __m128 detSub = _mm_sub_ps(
+      _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)),
+                 _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+      _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)),
+                 _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+  __m128 detA = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 detB = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 detC = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 detD = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(3, 3, 3, 3));
+
+  __m128 dc = mat2AdjMulSse(d, c);
+  __m128 ab = mat2AdjMulSse(a, b);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2MulSse(b, dc));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2MulSse(c, ab));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdjSse(d, ab));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdjSse(a, dc));
+
+  __m128 detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+  __m128 tr = _mm_mul_ps(ab, _mm_shuffle_ps(dc, dc, _MM_SHUFFLE(3, 1, 2, 0)));
+  tr = _mm_hadd_ps(tr, tr);
+  tr = _mm_hadd_ps(tr, tr);
+  detM = _mm_sub_ps(detM, tr);
+
+  __m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+  x = _mm_mul_ps(x, rDetM);
+  y = _mm_mul_ps(y, rDetM);
+  z = _mm_mul_ps(z, rDetM);
+  w = _mm_mul_ps(w, rDetM);
+
+  _mm_storeu_ps(res, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(res + 4, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+  _mm_storeu_ps(res + 8, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(res + 12, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+}
+
+// SSE version of reference::mat4AffineInverse: the squared norms of the
+// rows are a sum of columns, the rows of the inverse a transpose away
+__attribute__((target("sse4.1"))) static void
+mat4AffineInverseSse(const float *m, float *res) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 c0 = _mm_loadu_ps(m);
+  __m128 c1 = _mm_loadu_ps(m + 4);
+  __m128 c2 = _mm_loadu_ps(m + 8);
+  __m128 norm2 = _mm_add_ps(_mm_mul_ps(c0, c0), _mm_mul_ps(c1, c1));
+  norm2 = _mm_add_ps(norm2, _mm_mul_ps(c2, c2));
+  // The last lane is the bottom row (0 0 0 1), kept away from 1 / 0
+  __m128 invNorm2 = _mm_div_ps(one, _mm_blend_ps(norm2, one, 0x8));
+  __m128 r0 = _mm_mul_ps(c0, invNorm2);
+  __m128 r1 = _mm_mul_ps(c1, invNorm2);
+  __m128 r2 = _mm_mul_ps(c2, invNorm2);
+  __m128 r3 = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  __m128 t = _mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(m[12])),
+                        _mm_mul_ps(r1, _mm_set1_ps(m[13])));
+  t = _mm_add_ps(t, _mm_mul_ps(r2, _mm_set1_ps(m[14])));
+  // Negate flipping the sign bit, like the scalar minus
+  t = _mm_xor_ps(t, _mm_set1_ps(-0.0f));
+  _mm_storeu_ps(res, r0);
+  _mm_storeu_ps(res + 4, r1);
+  _mm_storeu_ps(res + 8, r2);
+  _mm_storeu_ps(res + 12, _mm_blend_ps(t, one, 0x8));
+}
+
+// Lanes of reference::sincos, the caller checks the angle range
+__attribute__((target("sse4.1"))) static inline void
+sincosBlockSse(__m128 x, __m128 &s, __m128 &c) {
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  const __m128 k = _mm_mul_ps(x, _mm_set1_ps(0.636619772367581343f));
+  const __m128 half =
+      _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(k, _mm_set1_ps(-0.0f)));
+  const __m128i j = _mm_cvttps_epi32(_mm_add_ps(k, half));
+  const __m128 jf = _mm_cvtepi32_ps(j);
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(7.54978995489188216e-8f)));
+  const __m128 z = _mm_mul_ps(r, r);
+
+  __m128 sr = _mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z);
+  sr = _mm_mul_ps(_mm_add_ps(sr, _mm_set1_ps(8.3321608736e-3f)), z);
+  sr = _mm_mul_ps(_mm_add_ps(sr, _mm_set1_ps(-1.6666654611e-1f)), z);
+  sr = _mm_add_ps(_mm_mul_ps(sr, r), r);
+  __m128 cr = _mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z);
+  cr = _mm_mul_ps(_mm_add_ps(cr, _mm_set1_ps(-1.388731625493765e-3f)), z);
+  cr = _mm_mul_ps(_mm_add_ps(cr, _mm_set1_ps(4.166664568298827e-2f)), z);
+  cr = _mm_sub_ps(_mm_mul_ps(cr, z), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+  cr = _mm_add_ps(cr, _mm_set1_ps(1.0f));
+
+  // Odd quadrants swap sin and cos, then the sign bits are set
+  const __m128 swap =
+      _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+  const __m128 sinSign =
+      _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+  const __m128 cosSign = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), 30));
+  s = _mm_xor_ps(_mm_blendv_ps(sr, cr, swap), sinSign);
+  c = _mm_xor_ps(_mm_blendv_ps(cr, sr, swap), cosSign);
+}
+
+__attribute__((target("avx2"))) static inline void
+sincosBlockAvx2(__m256 x, __m256 &s, __m256 &c) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256 k = _mm256_mul_ps(x, _mm256_set1_ps(0.636619772367581343f));
+  const __m256 half = _mm256_or_ps(_mm256_set1_ps(0.5f),
+                                   _mm256_and_ps(k, _mm256_set1_ps(-0.0f)));
+  const __m256i j = _mm256_cvttps_epi32(_mm256_add_ps(k, half));
+  const __m256 jf = _mm256_cvtepi32_ps(j);
+  __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(jf, _mm256_set1_ps(1.5703125f)));
+  r = _mm256_sub_ps(
+      r, _mm256_mul_ps(jf, _mm256_set1_ps(4.837512969970703125e-4f)));
+  r = _mm256_sub_ps(
+      r, _mm256_mul_ps(jf, _mm256_set1_ps(7.54978995489188216e-8f)));
+  const __m256 z = _mm256_mul_ps(r, r);
+
+  __m256 sr = _mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), z);
+  sr = _mm256_mul_ps(_mm256_add_ps(sr, _mm256_set1_ps(8.3321608736e-3f)), z);
+  sr = _mm256_mul_ps(_mm256_add_ps(sr, _mm256_set1_ps(-1.6666654611e-1f)), z);
+  sr = _mm256_add_ps(_mm256_mul_ps(sr, r), r);
+  __m256 cr = _mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), z);
+  cr = _mm256_mul_ps(
+      _mm256_add_ps(cr, _mm256_set1_ps(-1.388731625493765e-3f)), z);
+  cr = _mm256_mul_ps(
+      _mm256_add_ps(cr, _mm256_set1_ps(4.166664568298827e-2f)), z);
+  cr = _mm256_sub_ps(_mm256_mul_ps(cr, z),
+                     _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+  cr = _mm256_add_ps(cr, _mm256_set1_ps(1.0f));
+
+  const __m256 swap = _mm256_castsi256_ps(
+      _mm256_cmpeq_epi32(_mm256_and_si256(j, one), one));
+  const __m256 sinSign =
+      _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, two), 30));
+  const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(_mm256_add_epi32(j, one), two), 30));
+  s = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap), sinSign);
+  c = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap), cosSign);
+}
+
+// Blocks containing angles out of the polynomial range (rare) go through
+// the reference, so that every lane falls back to <cmath> in the same way
+__attribute__((target("sse4.1"))) static void
+sincosSse(const float *x, std::size_t n, float *s, float *c) {
+  const __m128 maxAngle = _mm_set1_ps(reference::SINCOS_MAX_ANGLE);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_loadu_ps(x + i);
+    __m128 inRange =
+        _mm_cmple_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), v), maxAngle);
+    if (_mm_movemask_ps(inRange) != 0xF) {
+      sincosScalar(x + i, 4, s + i, c + i);
+      continue;
+    }
+    __m128 sv, cv;
+    sincosBlockSse(v, sv, cv);
+    _mm_storeu_ps(s + i, sv);
+    _mm_storeu_ps(c + i, cv);
+  }
+  sincosScalar(x + i, n - i, s + i, c + i);
+}
+
+__attribute__((target("avx2"))) static void
+sincosAvx2(const float *x, std::size_t n, float *s, float *c) {
+  const __m256 maxAngle = _mm256_set1_ps(reference::SINCOS_MAX_ANGLE);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(x + i);
+    __m256 inRange = _mm256_cmp_ps(
+        _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v), maxAngle, _CMP_LE_OQ);
+    if (_mm256_movemask_ps(inRange) != 0xFF) {
+      _mm256_zeroupper();
+      sincosScalar(x + i, 8, s + i, c + i);
+      continue;
+    }
+    __m256 sv, cv;
+    sincosBlockAvx2(v, sv, cv);
+    _mm256_storeu_ps(s + i, sv);
+    _mm256_storeu_ps(c + i, cv);
+  }
+  _mm256_zeroupper();
+  sincosScalar(x + i, n - i, s + i, c + i);
+}
+#endif // MATRIX_SIMD_X86
+
+static constexpr MatrixKernels scalarKernels{
+    ISA::SCALAR, mat4MulScalar, mat4MulVecScalar, mat4MultByDiagonalScalar,
+    buildModelMatricesScalar, mat4InverseScalar, mat4AffineInverseScalar,
+    cullSpheresScalar, sincosScalar};
+#ifdef MATRIX_SIMD_X86
+static constexpr MatrixKernels sseKernels{
+    ISA::SSE4, mat4MulSse, mat4MulVecSse, mat4MultByDiagonalSse,
+    buildModelMatricesSse, mat4InverseSse, mat4AffineInverseSse,
+    cullSpheresSse, sincosSse};
+// A 4-wide matrix-vector product doesn't benefit from 256 bit registers
+static constexpr MatrixKernels avx2Kernels{
+    ISA::AVX2, mat4MulAvx2, mat4MulVecSse, mat4MultByDiagonalAvx2,
+    buildModelMatricesAvx2, mat4InverseSse, mat4AffineInverseSse,
+    cullSpheresAvx2, sincosAvx2};
+#endif
+
+bool isSupported(ISA isa) {
+  switch (isa) {
+  case ISA::SCALAR:
+    return true;
+#ifdef MATRIX_SIMD_X86
+  case ISA::SSE4:
+    return __builtin_cpu_supports("sse4.1");
+  case ISA::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+const MatrixKernels &kernels(ISA isa) {
+  if (!isSupported(isa)) {
+    throw std::runtime_error("Instruction set not supported by the CPU!");
+  }
+#ifdef MATRIX_SIMD_X86
+  if (isa == ISA::AVX2)
+    return avx2Kernels;
+  if (isa == ISA::SSE4)
+    return sseKernels;
+#endif
+  return scalarKernels;
+}
+
+static const MatrixKernels &detectKernels() {
+  for (ISA isa : {ISA::AVX2, ISA::SSE4}) {
+    if (isSupported(isa))
+      return kernels(isa);
+  }
+  return scalarKernels;
+}
+
+const MatrixKernels &kernels() {
+  static const MatrixKernels &selected = detectKernels();
+  return selected;
+}
+
+std::string_view isaName(ISA isa) {
+  switch (isa) {
+  case ISA::SCALAR:
+    return "scalar";
+  case ISA::SSE4:
+    return "sse4.1";
+  case ISA::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+} // namespace simd
@@ -0,0 +1,262 @@
+#ifndef MATRIX_SIMD_C
+#define MATRIX_SIMD_C
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Hand vectorized kernels for the 4x4 float operations that dominate the
+// CPU side of a frame (model matrices, camera matrices, PVM products,
+// frustum culling, rotation angles).
+// Kernels work on raw column-major arrays so that this header doesn't depend
+// on Matrix.h. Every implementation performs the same floating point
+// operations in the same order of the generic loops in Matrix.h (or of the
+// reference implementation below), therefore results are bit-identical
+// whatever instruction set is selected.
+namespace simd {
+
+enum class ISA { SCALAR, SSE4, AVX2 };
+
+// Structure of arrays input of buildModelMatrices, n entities.
+// Rotation is given as a unit quaternion w + xi + yj + zk.
+struct TransformSoA {
+  const float *px, *py, *pz;
+  const float *scale;
+  const float *qw, *qx, *qy, *qz;
+  std::size_t n;
+};
+
+// Structure of arrays of n bounding spheres, input of cullSpheres
+struct SphereSoA {
+  const float *cx, *cy, *cz;
+  const float *radius;
+  std::size_t n;
+};
+
+struct MatrixKernels {
+  ISA isa;
+  // res = a * b
+  void (*mat4Mul)(const float *a, const float *b, float *res);
+  // res = m * v
+  void (*mat4MulVec)(const float *m, const float *v, float *res);
+  // m = m * diag(d)
+  void (*mat4MultByDiagonal)(float *m, const float *d);
+  // out[i] = translate(p_i) * scale_i * rotation(q_i),
+  // out is an array of n column-major 4x4 matrices
+  void (*buildModelMatrices)(const TransformSoA &in, float *out);
+  // res = m^-1, m must be invertible
+  void (*mat4Inverse)(const float *m, float *res);
+  // res = m^-1 for m = T * S * R, see reference::mat4AffineInverse
+  void (*mat4AffineInverse)(const float *m, float *res);
+  // Writes in ascending order the indices of the spheres that are not
+  // completely outside the 6 planes (a, b, c, d), stored one after the
+  // other, and returns how many they are. Inside points have
+  // a*x + b*y + c*z + d >= 0, normals must be versors.
+  // visible must have room for n indices.
+  std::size_t (*cullSpheres)(const float *planes, const SphereSoA &in,
+                             std::uint32_t *visible);
+  // s[i] = sin(x[i]), c[i] = cos(x[i]), see reference::sincos
+  void (*sincos)(const float *x, std::size_t n, float *s, float *c);
+};
+
+/**
+ * Kernels of the best instruction set supported by the running CPU.
+ * The detection is done only once, at the first call.
+ */
+const MatrixKernels &kernels();
+/**
+ * Kernels of a specific instruction set, useful to validate and benchmark
+ * the different implementations. Throws if the CPU doesn't support isa.
+ */
+const MatrixKernels &kernels(ISA isa);
+bool isSupported(ISA isa);
+std::string_view isaName(ISA isa);
+
+namespace reference {
+// m = m * diag(d), the loop of mat::multByDiagonal at compile time
+constexpr void mat4MultByDiagonal(float *m, const float *d) {
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 4; i++) {
+      m[i + j * 4] = m[i + j * 4] * d[j];
+    }
+  }
+}
+
+// Scalar reference of the SIMD inverse, it's also used at compile time.
+// Block-wise inversion with 2x2 sub-matrices, see
+// https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+// Written for row-major matrices, it works as it is on column-major ones
+// since (m^T)^-1 = (m^-1)^T. Every helper mirrors an SSE instruction.
+using f4 = std::array<float, 4>;
+
+constexpr f4 add(const f4 &a, const f4 &b) {
+  return {a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]};
+}
+constexpr f4 sub(const f4 &a, const f4 &b) {
+  return {a[0] - b[0], a[1] - b[1], a[2] - b[2], a[3] - b[3]};
+}
+constexpr f4 mul(const f4 &a, const f4 &b) {
+  return {a[0] * b[0], a[1] * b[1], a[2] * b[2], a[3] * b[3]};
+}
+// _mm_shuffle_ps(a, b, (x, y, z, w))
+constexpr f4 shuffle(const f4 &a, const f4 &b, int x, int y, int z, int w) {
+  return {a[x], a[y], b[z], b[w]};
+}
+constexpr f4 swizzle(const f4 &a, int x, int y, int z, int w) {
+  return shuffle(a, a, x, y, z, w);
+}
+constexpr f4 broadcast(const f4 &a, int x) { return swizzle(a, x, x, x, x); }
+
+// 2x2 matrices products, A# is the adjugate of A
+// A * B
+constexpr f4 mat2Mul(const f4 &a, const f4 &b) {
+  return add(mul(a, swizzle(b, 0, 3, 0, 3)),
+             mul(swizzle(a, 1, 0, 3, 2), swizzle(b, 2, 1, 2, 1)));
+}
+// A# * B
+constexpr f4 mat2AdjMul(const f4 &a, const f4 &b) {
+  return sub(mul(swizzle(a, 3, 3, 0, 0), b),
+             mul(swizzle(a, 1, 1, 2, 2), swizzle(b, 2, 3, 0, 1)));
+}
+// A * B#
+constexpr f4 mat2MulAdj(const f4 &a, const f4 &b) {
+  return sub(mul(a, swizzle(b, 3, 0, 3, 0)),
+             mul(swizzle(a, 1, 0, 3, 2), swizzle(b, 2, 1, 2, 1)));
+}
+
+constexpr void mat4Inverse(const float *m, float *res) {
+  const f4 r0{m[0], m[1], m[2], m[3]};
+  const f4 r1{m[4], m[5], m[6], m[7]};
+  const f4 r2{m[8], m[9], m[10], m[11]};
+  const f4 r3{m[12], m[13], m[14], m[15]};
+  // m = | A B |
+  //     | C D |
+  f4 a = shuffle(r0, r1, 0, 1, 0, 1);
+  f4 b = shuffle(r0, r1, 2, 3, 2, 3);
+  f4 c = shuffle(r2, r3, 0, 1, 0, 1);
+  f4 d = shuffle(r2, r3, 2, 3, 2, 3);
+
+  // (|A|, |B|, |C|, |D|)
+  f4 detSub = sub(mul(shuffle(r0, r2, 0, 2, 0, 2), shuffle(r1, r3, 1, 3, 1, 3)),
+                  mul(shuffle(r0, r2, 1, 3, 1, 3), shuffle(r1, r3, 0, 2, 0, 2)));
+  f4 detA = broadcast(detSub, 0);
+  f4 detB = broadcast(detSub, 1);
+  f4 detC = broadcast(detSub, 2);
+  f4 detD = broadcast(detSub, 3);
+
+  // m^-1 = 1/|m| * | X Y |
+  //                | Z W |
+  f4 dc = mat2AdjMul(d, c);
+  f4 ab = mat2AdjMul(a, b);
+  // X# = |D|A - B(D#C)
+  f4 x = sub(mul(detD, a), mat2Mul(b, dc));
+  // W# = |A|D - C(A#B)
+  f4 w = sub(mul(detA, d), mat2Mul(c, ab));
+  // Y# = |B|C - D(A#B)#
+  f4 y = sub(mul(detB, c), mat2MulAdj(d, ab));
+  // Z# = |C|B - A(D#C)#
+  f4 z = sub(mul(detC, b), mat2MulAdj(a, dc));
+
+  // |m| = |A||D| + |B||C| - tr((A#B)(D#C))
+  f4 detM = add(mul(detA, detD), mul(detB, detC));
+  f4 tr = mul(ab, swizzle(dc, 0, 2, 1, 3));
+  float trace = (tr[0] + tr[1]) + (tr[2] + tr[3]);
+  detM = sub(detM, f4{trace, trace, trace, trace});
+
+  f4 rDetM{1.0f / detM[0], -1.0f / detM[1], -1.0f / detM[2], 1.0f / detM[3]};
+  x = mul(x, rDetM);
+  y = mul(y, rDetM);
+  z = mul(z, rDetM);
+  w = mul(w, rDetM);
+
+  // Adjugates and final layout in a single shuffle
+  const f4 rows[4] = {shuffle(x, y, 3, 1, 3, 1), shuffle(x, y, 2, 0, 2, 0),
+                      shuffle(z, w, 3, 1, 3, 1), shuffle(z, w, 2, 0, 2, 0)};
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      res[4 * i + j] = rows[i][j];
+    }
+  }
+}
+
+/**
+ * Inverse of m = T * S * R with S diagonal and R a rotation, like
+ * mat::modelMatrix. The rows of the linear part SR are orthogonal, row i
+ * has norm s_i, so (SR)^-1 = R^T S^-1 has as column i the row i of SR
+ * divided by its squared norm. The translation is -(SR)^-1 t.
+ * Sums are done column by column, like the SIMD lanes.
+ */
+constexpr void mat4AffineInverse(const float *m, float *res) {
+  float invNorm2[3];
+  for (int i = 0; i < 3; i++) {
+    const float norm2 = m[i] * m[i] + m[4 + i] * m[4 + i];
+    invNorm2[i] = 1.0f / (norm2 + m[8 + i] * m[8 + i]);
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      res[4 * i + j] = m[4 * j + i] * invNorm2[i];
+    }
+    res[4 * i + 3] = 0.0f;
+  }
+  for (int j = 0; j < 3; j++) {
+    res[12 + j] =
+        -((res[j] * m[12] + res[4 + j] * m[13]) + res[8 + j] * m[14]);
+  }
+  res[15] = 1.0f;
+}
+
+// Largest angle handled by the polynomial sincos, j * pi/2 is computed
+// exactly for |j| < 2^13
+inline constexpr float SINCOS_MAX_ANGLE = 8192.0f;
+
+/**
+ * Fast sin and cos, reference of the sincos kernels.
+ * x is reduced to r in [-pi/4, pi/4] subtracting the nearest multiple of
+ * pi/2 (Cody-Waite, pi/2 split in 3 floats), then the minimax polynomials
+ * of Cephes sinf/cosf are evaluated on r and swapped/negated according to
+ * the quadrant. Max absolute error 1.2e-7 (1 ulp of 1.0f) for
+ * |x| <= SINCOS_MAX_ANGLE, larger angles, infinities and NaN fall back to
+ * <cmath>.
+ */
+inline void sincos(float x, float &s, float &c) {
+  if (!(std::fabs(x) <= SINCOS_MAX_ANGLE)) {
+    s = std::sin(x);
+    c = std::cos(x);
+    return;
+  }
+  // Round to nearest, ties away from zero
+  const float k = x * 0.636619772367581343f;
+  const int j = static_cast<int>(k + std::copysign(0.5f, k));
+  const float jf = static_cast<float>(j);
+  float r = x - jf * 1.5703125f;
+  r = r - jf * 4.837512969970703125e-4f;
+  r = r - jf * 7.54978995489188216e-8f;
+  const float z = r * r;
+
+  float sr = -1.9515295891e-4f * z;
+  sr = (sr + 8.3321608736e-3f) * z;
+  sr = (sr + -1.6666654611e-1f) * z;
+  sr = sr * r + r;
+  float cr = 2.443315711809948e-5f * z;
+  cr = (cr + -1.388731625493765e-3f) * z;
+  cr = (cr + 4.166664568298827e-2f) * z;
+  cr = cr * z - 0.5f * z;
+  cr = cr + 1.0f;
+
+  // Quadrant j mod 4: (sin, cos) = (s, c), (c, -s), (-s, -c), (-c, s).
+  // Branchless, the quadrants of random angles are unpredictable
+  const bool swap = j & 1;
+  const std::uint32_t sinSign = static_cast<std::uint32_t>(j & 2) << 30;
+  const std::uint32_t cosSign = static_cast<std::uint32_t>((j + 1) & 2) << 30;
+  s = std::bit_cast<float>(std::bit_cast<std::uint32_t>(swap ? cr : sr) ^
+                           sinSign);
+  c = std::bit_cast<float>(std::bit_cast<std::uint32_t>(swap ? sr : cr) ^
+                           cosSign);
+}
+} // namespace reference
+} // namespace simd
+
+#endif // MATRIX_SIMD_C
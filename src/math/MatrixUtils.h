@@ -2,24 +2,59 @@
 #define MATRIX_UTILS_C
 
 #include "Matrix.h"
+#include "Quaternion.h"
+#include "Trig.h"
 
 namespace mat {
-inline float distance2(const Vec3f &v1, const Vec3f &v2) {
-  Vec3f v3 = v1 - v2;
-  return v3.norm2();
+// Squared norm of a (possibly lazy) expression, without evaluating it
+// into a temporary
+template <expr::MatrixExpression E>
+constexpr typename E::value_type norm2(const E &e) {
+  typename E::value_type res = 0;
+  for (size_t i = 0; i < E::rows * E::cols; i++) {
+    res += e[i] * e[i];
+  }
+  return res;
+}
+template <typename T>
+constexpr T distance2(const Vector<T, 3> &v1, const Vector<T, 3> &v2) {
+  return norm2(v1 - v2);
+}
+// position - origin, computed in double precision and then narrowed:
+// small offsets stay exact even far away from the world origin
+constexpr Vec3f relativePosition(const Vec3d &position, const Vec3d &origin) {
+  return Vec3d{position - origin}.cast<float>();
+}
+// Linear part (rotation and scale) of an affine transformation applied to a
+// double precision vector
+constexpr Vec3d transformDirection(const Mat4f &m, const Vec3d &v) {
+  Vec3d res;
+  for (int i = 0; i < 3; i++) {
+    res(i) = double(m(i, 0)) * v(0) + double(m(i, 1)) * v(1) +
+             double(m(i, 2)) * v(2);
+  }
+  return res;
 }
 // Returns the identity matrix
-inline Mat4f identity() {
+constexpr Mat4f identity() {
   Mat4f id;
   id(0, 0) = id(1, 1) = id(2, 2) = id(3, 3) = 1.0;
   return id;
 }
-template <typename T> [[nodiscard]] inline T normalize(T mat) {
+template <typename T>
+  requires(!expr::isNode<T>)
+[[nodiscard]] constexpr T normalize(T mat) {
   mat /= mat.norm();
   return mat;
 }
+// Lazy expressions are evaluated once and then normalized
+template <expr::MatrixExpression E>
+  requires expr::isNode<E>
+[[nodiscard]] constexpr auto normalize(const E &e) {
+  return normalize(Matrix<typename E::value_type, E::rows, E::cols>{e});
+}
 // Returns the translation matrix associated to translationVector
-inline Mat4f translate(const Vec3f &translationVector) {
+constexpr Mat4f translate(const Vec3f &translationVector) {
   Mat4f translationMatrix = identity();
   for (int i = 0; i < 3; i++) {
     translationMatrix(i, 3) = translationVector(i);
@@ -27,7 +62,7 @@ inline Mat4f translate(const Vec3f &translationVector) {
   return translationMatrix;
 }
 // Returns the scaling matrix associated to scalingVector
-inline Mat4f scale(const Vec3f &scalingVector) {
+constexpr Mat4f scale(const Vec3f &scalingVector) {
   Mat4f scalingMatrix = identity();
   for (int i = 0; i < 3; i++) {
     scalingMatrix(i, i) = scalingVector(i);
@@ -35,12 +70,12 @@ inline Mat4f scale(const Vec3f &scalingVector) {
   return scalingMatrix;
 }
 // Returns the rotation matrix of angle theta around the versor direction
-inline Mat4f rotate(float theta, const Vec3f &direction) {
+constexpr Mat4f rotate(float theta, const Vec3f &direction) {
   float ux = direction(0);
   float uy = direction(1);
   float uz = direction(2);
-  float ct = std::cos(theta);
-  float st = std::sin(theta);
+  float ct, st;
+  sincos(theta, st, ct);
 
   Mat4f rotationMatrix = identity();
   // See
@@ -67,25 +102,89 @@ inline Mat4f rotate(float theta, const Vec3f &direction) {
  * @param diag - Diagonal elements of a diagonal matrix
  * @return mat*diag
  */
-inline void multByDiagonal(Mat4f &mat, const Vec4f &diag) {
-  for (size_t j = 0; j < 4; j++) {
-    for (size_t i = 0; i < 4; i++) {
-      mat(i, j) = mat(i, j) * diag(j);
-    }
+constexpr void multByDiagonal(Mat4f &mat, const Vec4f &diag) {
+  if consteval {
+    simd::reference::mat4MultByDiagonal(mat.data().data(),
+                                        diag.data().data());
+  } else {
+    simd::kernels().mat4MultByDiagonal(mat.data().data(), diag.data().data());
   }
 }
+// Model matrix of an object, translate(position) * diag(scale) * rotation
+constexpr Mat4f modelMatrix(const Vec3f &position, const Vec4f &scale,
+                            const Quatf &rotation) {
+  Mat4f translation = translate(position);
+  multByDiagonal(translation, scale);
+  return translation * rotation.toMat4();
+}
 // Returns cross product between v1 and v2
-inline Vec3f cross(const Vec3f &v1, const Vec3f &v2) {
+constexpr Vec3f cross(const Vec3f &v1, const Vec3f &v2) {
   return Vec3f(v1(1) * v2(2) - v1(2) * v2(1), v1(2) * v2(0) - v1(0) * v2(2),
                v1(0) * v2(1) - v1(1) * v2(0));
 }
+/**
+ * General 4x4 inverse.
+ * @param m - invertible matrix, no check is done
+ * @return m^-1
+ */
+constexpr Mat4f inverse(const Mat4f &m) {
+  Mat4f res;
+  if consteval {
+    simd::reference::mat4Inverse(m.data().data(), res.data().data());
+  } else {
+    simd::kernels().mat4Inverse(m.data().data(), res.data().data());
+  }
+  return res;
+}
+
+/**
+ * Fast inverse of a model matrix M = T * S * R (S diagonal, R rotation),
+ * the matrices built by modelMatrix. The rows of the linear part are
+ * orthogonal, so (SR)^-1 = R^T S^-1: the inverse needs neither
+ * determinants nor divisions other than the three squared row norms.
+ * @param m - T * S * R matrix, the result is wrong for other matrices
+ * @return m^-1
+ */
+constexpr Mat4f affineInverse(const Mat4f &m) {
+  Mat4f res;
+  if consteval {
+    simd::reference::mat4AffineInverse(m.data().data(), res.data().data());
+  } else {
+    simd::kernels().mat4AffineInverse(m.data().data(), res.data().data());
+  }
+  return res;
+}
+
+/**
+ * Matrix that transforms normals: inverse transpose of the linear part of m.
+ * Computed from the cofactors, valid for every invertible affine matrix.
+ * @param m - affine transformation
+ * @return ((m_3x3)^-1)^T
+ */
+constexpr Mat3f normalMatrix(const Mat4f &m) {
+  Mat3f cof;
+  // cofactor(i, j) = (-1)^(i+j) minor(i, j), computed with cyclic indices
+  // which take care of the sign automatically
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = 0; j < 3; j++) {
+      size_t i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      size_t j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+      cof(i, j) = m(i1, j1) * m(i2, j2) - m(i1, j2) * m(i2, j1);
+    }
+  }
+  float det = m(0, 0) * cof(0, 0) + m(0, 1) * cof(0, 1) + m(0, 2) * cof(0, 2);
+  // (A^-1)^T = cof(A) / |A|
+  cof /= det;
+  return cof;
+}
+
 // Implements the "View Matrix step" of the PVM change of coordinate
 // See https://www.songho.ca/opengl/gl_camera.html#lookat
 // eyePosition: position of the eye (camera)
 // targetPosition: position at which the eye is looking
 // upVector: uniquely determine the cartesian axis of the eye
-inline Mat4f lookAt(const Vec3f &eyePosition, const Vec3f &targetPosition,
-                    const Vec3f &upVector) {
+constexpr Mat4f lookAt(const Vec3f &eyePosition,
+                       const Vec3f &targetPosition, const Vec3f &upVector) {
   // z-axis of the eye coordinate system
   Vec3f eyeDirection = normalize(eyePosition - targetPosition);
 
@@ -112,8 +211,8 @@ inline Mat4f lookAt(const Vec3f &eyePosition, const Vec3f &targetPosition,
 // Implements the most generic "Projection Matrix step" of the PVM change of
 // coordinate, Perspective is taken in account See
 // https://www.songho.ca/opengl/gl_projectionmatrix.html
-inline Mat4f perspectiveProjection(float r, float l, float b, float t, float n,
-                                   float f) {
+constexpr Mat4f perspectiveProjection(float r, float l, float b, float t,
+                                      float n, float f) {
   Mat4f res;
   res(0, 0) = 2 * n / (r - l);
   res(0, 2) = (r + l) / (r - l);
@@ -132,9 +231,9 @@ inline Mat4f perspectiveProjection(float r, float l, float b, float t, float n,
 // r = -l
 // t = -b
 // parameterized by the fov angle and the aspect ratio
-inline Mat4f perspectiveProjection(float fov, float aspectRatio, float n,
-                                   float f) {
-  float tangent = tan(fov / 2);
+constexpr Mat4f perspectiveProjection(float fov, float aspectRatio, float n,
+                                      float f) {
+  float tangent = constmath::tan(fov / 2);
   float t = n * tangent;
   float r = t * aspectRatio;
   return perspectiveProjection(r, -r, -t, t, n, f);
@@ -143,8 +242,8 @@ inline Mat4f perspectiveProjection(float fov, float aspectRatio, float n,
 // Implements the most generic "Projection Matrix step" of the PVM change of
 // coordinate, Perspective is NOT taken in account See
 // https://www.songho.ca/opengl/gl_projectionmatrix.html
-inline Mat4f orthographicProjection(float r, float l, float b, float t, float n,
-                                    float f) {
+constexpr Mat4f orthographicProjection(float r, float l, float b, float t,
+                                       float n, float f) {
   Mat4f res = identity();
   res(0, 0) = 2 / (r - l);
   res(0, 3) = -(r + l) / (r - l);
@@ -160,11 +259,67 @@ inline Mat4f orthographicProjection(float r, float l, float b, float t, float n,
 // Overload in the special symmetric case
 // r = -l
 // t = -b
-inline Mat4f orthographicProjection(float r, float t, float n, float f) {
+constexpr Mat4f orthographicProjection(float r, float t, float n, float f) {
   return orthographicProjection(r, -r, -t, t, n, f);
 }
 
-inline float toRads(float degrees) { return degrees * (M_PI / 180); }
+constexpr float toRads(float degrees) { return degrees * (M_PI / 180); }
+
+// Compile time checks, they cost nothing at runtime
+namespace checks {
+static_assert(identity()(0, 0) == 1.0f && identity()(0, 1) == 0.0f);
+static_assert(translate(Vec3f{1.0f, 2.0f, 3.0f}) * Vec4f{1.0f, 1.0f, 1.0f,
+                                                        1.0f} ==
+              Vec4f{2.0f, 3.0f, 4.0f, 1.0f});
+static_assert(scale(Vec3f{2.0f, 3.0f, 4.0f}) * identity() ==
+              scale(Vec3f{2.0f, 3.0f, 4.0f}));
+static_assert(toRads(180.0f) == static_cast<float>(M_PI));
+static_assert(cross(Vec3f{1.0f, 0.0f, 0.0f}, Vec3f{0.0f, 1.0f, 0.0f}) ==
+              Vec3f{0.0f, 0.0f, 1.0f});
+static_assert(Vec3f{3.0f, 0.0f, 4.0f}.norm() == 5.0f);
+static_assert(distance2(Vec3f{1.0f, 1.0f, 1.0f}, Vec3f{2.0f, 3.0f, 4.0f}) ==
+              14.0f);
+// A rotation of pi/2 around z maps x to y
+static_assert(norm2(rotate(toRads(90.0f), Vec3f{0.0f, 0.0f, 1.0f}) *
+                        Vec4f{1.0f, 0.0f, 0.0f, 1.0f} -
+                    Vec4f{0.0f, 1.0f, 0.0f, 1.0f}) < 1e-12f);
+// Looking from +z towards the origin doesn't rotate, only translates
+static_assert(lookAt(Vec3f{0.0f, 0.0f, 3.0f}, Vec3f{0.0f, 0.0f, 0.0f},
+                     Vec3f{0.0f, 1.0f, 0.0f}) ==
+              translate(Vec3f{0.0f, 0.0f, -3.0f}));
+// The near plane is mapped to z = -1 and the far plane to z = 1
+static_assert(orthographicProjection(1.0f, 1.0f, 0.1f, 100.0f) *
+                  Vec4f{0.0f, 0.0f, -0.1f, 1.0f} ==
+              Vec4f{0.0f, 0.0f, -1.0f, 1.0f});
+constexpr Mat4f perspective90 =
+    perspectiveProjection(toRads(90.0f), 1.0f, 1.0f, 10.0f);
+static_assert(perspective90(3, 2) == -1.0f);
+static_assert((perspective90(0, 0) - 1.0f) * (perspective90(0, 0) - 1.0f) <
+              1e-12f);
+// translate(1, 2, 3) * rotate(pi/2, z) * scale(2)
+constexpr Mat4f rstMatrix = translate(Vec3f{1.0f, 2.0f, 3.0f}) *
+                            rotate(toRads(90.0f), Vec3f{0.0f, 0.0f, 1.0f}) *
+                            scale(Vec3f{2.0f, 2.0f, 2.0f});
+static_assert(norm2(inverse(rstMatrix) * rstMatrix - identity()) < 1e-12f);
+// Non uniform scale, the linear part has orthogonal rows but not columns
+constexpr Mat4f entityMatrix = modelMatrix(
+    Vec3f{1.0f, -2.0f, 3.0f}, Vec4f{2.0f, 0.5f, 3.0f, 1.0f},
+    Quatf::fromAxisAngle(0.7f, Vec3f{0.6f, 0.0f, 0.8f}));
+static_assert(norm2(affineInverse(entityMatrix) * entityMatrix -
+                    identity()) < 1e-10f);
+static_assert(norm2(entityMatrix * affineInverse(entityMatrix) -
+                    identity()) < 1e-10f);
+static_assert(norm2(inverse(perspective90) * perspective90 - identity()) <
+              1e-12f);
+// A quarter of the way from no rotation to pi/2 around z
+static_assert(1.0f - dot(slerp(Quatf{1.0f, 0.0f, 0.0f, 0.0f},
+                               Quatf::fromAxisAngle(toRads(90.0f),
+                                                    Vec3f{0.0f, 0.0f, 1.0f}),
+                               0.25f),
+                         Quatf::fromAxisAngle(toRads(22.5f),
+                                              Vec3f{0.0f, 0.0f, 1.0f})) <
+              1e-6f);
+} // namespace checks
 } // namespace mat
 
 #endif // MATRIX_UTILS_C
\ No newline at end of file
@@ -0,0 +1,182 @@
+#ifndef QUATERNION_C
+#define QUATERNION_C
+
+#include "ConstexprMath.h"
+#include "Matrix.h"
+#include "Trig.h"
+
+/**
+ * Quaternion w + xi + yj + zk.
+ * Unit quaternions represent rotations: composing two rotations is a
+ * single product (16 multiplications) instead of a 4x4 matrix product,
+ * and they can be interpolated smoothly (see slerp, nlerp).
+ */
+template <typename T> class Quaternion {
+public:
+  T w{1}, x{0}, y{0}, z{0};
+
+  // Identity rotation
+  constexpr Quaternion() = default;
+  constexpr Quaternion(T w, T x, T y, T z) : w{w}, x{x}, y{y}, z{z} {};
+  /**
+   * Rotation of angle theta around direction
+   * @param theta - angle in radians
+   * @param direction - rotation axis, must be a versor
+   */
+  static constexpr Quaternion fromAxisAngle(T theta,
+                                            const Vector<T, 3> &direction);
+
+  constexpr bool operator==(const Quaternion &q) const = default;
+  constexpr Quaternion &operator*=(const Quaternion &q);
+  constexpr Quaternion &operator*=(T c);
+  constexpr Quaternion &operator/=(T c);
+  constexpr Quaternion operator-() const { return {-w, -x, -y, -z}; }
+  constexpr Quaternion conjugate() const { return {w, -x, -y, -z}; }
+  constexpr T norm2() const { return w * w + x * x + y * y + z * z; }
+  constexpr T norm() const { return constmath::sqrt(norm2()); }
+
+  /**
+   * Applies a constant angular velocity for a time interval.
+   * The quaternion is renormalized to avoid the accumulation of errors.
+   * @param omega - angular velocity (axis * radians/second), world frame
+   * @param deltaT - time interval
+   */
+  constexpr void integrate(const Vector<T, 3> &omega, T deltaT);
+  // Rotation matrix, the quaternion must be unitary
+  constexpr Matrix<T, 4, 4> toMat4() const;
+};
+
+template <typename T>
+constexpr Quaternion<T>
+Quaternion<T>::fromAxisAngle(T theta, const Vector<T, 3> &direction) {
+  T halfSin, halfCos;
+  mat::sincos(theta / 2, halfSin, halfCos);
+  return {halfCos, direction(0) * halfSin, direction(1) * halfSin,
+          direction(2) * halfSin};
+}
+
+// Hamilton product
+template <typename T>
+constexpr Quaternion<T> operator*(const Quaternion<T> &a,
+                                  const Quaternion<T> &b) {
+  return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+          a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+template <typename T>
+constexpr Quaternion<T> operator*(const Quaternion<T> &q, T c) {
+  return {q.w * c, q.x * c, q.y * c, q.z * c};
+}
+
+template <typename T>
+constexpr Quaternion<T> operator+(const Quaternion<T> &a,
+                                  const Quaternion<T> &b) {
+  return {a.w + b.w, a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+template <typename T>
+constexpr Quaternion<T> &Quaternion<T>::operator*=(const Quaternion<T> &q) {
+  *this = *this * q;
+  return *this;
+}
+
+template <typename T>
+constexpr Quaternion<T> &Quaternion<T>::operator*=(T c) {
+  w *= c;
+  x *= c;
+  y *= c;
+  z *= c;
+  return *this;
+}
+
+template <typename T>
+constexpr Quaternion<T> &Quaternion<T>::operator/=(T c) {
+  return (*this) *= (1 / c);
+}
+
+template <typename T>
+constexpr void Quaternion<T>::integrate(const Vector<T, 3> &omega, T deltaT) {
+  T omegaNorm = omega.norm();
+  if (omegaNorm == 0)
+    return;
+  Vector<T, 3> axis = omega * (1 / omegaNorm);
+  // World frame angular velocity: the new rotation is applied last
+  *this = fromAxisAngle(omegaNorm * deltaT, axis) * (*this);
+  *this /= norm();
+}
+
+template <typename T>
+constexpr Matrix<T, 4, 4> Quaternion<T>::toMat4() const {
+  // See
+  // https://en.wikipedia.org/wiki/Quaternions_and_spatial_rotation#Quaternion-derived_rotation_matrix
+  const T xx = x * x, yy = y * y, zz = z * z;
+  const T xy = x * y, xz = x * z, yz = y * z;
+  const T wx = w * x, wy = w * y, wz = w * z;
+  Matrix<T, 4, 4> res;
+  res(0, 0) = 1 - 2 * (yy + zz);
+  res(0, 1) = 2 * (xy - wz);
+  res(0, 2) = 2 * (xz + wy);
+  res(1, 0) = 2 * (xy + wz);
+  res(1, 1) = 1 - 2 * (xx + zz);
+  res(1, 2) = 2 * (yz - wx);
+  res(2, 0) = 2 * (xz - wy);
+  res(2, 1) = 2 * (yz + wx);
+  res(2, 2) = 1 - 2 * (xx + yy);
+  res(3, 3) = 1;
+  return res;
+}
+
+namespace mat {
+template <typename T>
+constexpr T dot(const Quaternion<T> &a, const Quaternion<T> &b) {
+  return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename T>
+[[nodiscard]] constexpr Quaternion<T> normalize(Quaternion<T> q) {
+  q /= q.norm();
+  return q;
+}
+
+/**
+ * Normalized linear interpolation. Cheaper than slerp but the angular
+ * velocity is not constant along the path.
+ * @param t - in [0, 1], t = 0 returns a and t = 1 returns b
+ */
+template <typename T>
+constexpr Quaternion<T> nlerp(const Quaternion<T> &a, const Quaternion<T> &b,
+                              T t) {
+  // q and -q are the same rotation: take the shortest path
+  T sign = dot(a, b) < 0 ? -1 : 1;
+  return normalize(a * (1 - t) + b * (sign * t));
+}
+
+/**
+ * Spherical linear interpolation, constant angular velocity.
+ * @param t - in [0, 1], t = 0 returns a and t = 1 returns b
+ */
+template <typename T>
+constexpr Quaternion<T> slerp(const Quaternion<T> &a, const Quaternion<T> &b,
+                              T t) {
+  T cosOmega = dot(a, b);
+  T sign = 1;
+  if (cosOmega < 0) {
+    cosOmega = -cosOmega;
+    sign = -1;
+  }
+  // Almost parallel: sin(omega) ~ 0, nlerp is accurate and stable
+  if (cosOmega > T(0.9995))
+    return nlerp(a, b, t);
+  T omega = constmath::acos(cosOmega);
+  T invSin = 1 / constmath::sin(omega);
+  T ca = constmath::sin((1 - t) * omega) * invSin;
+  T cb = constmath::sin(t * omega) * invSin * sign;
+  return a * ca + b * cb;
+}
+} // namespace mat
+
+typedef Quaternion<float> Quatf;
+
+#endif // QUATERNION_C
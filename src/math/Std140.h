@@ -0,0 +1,51 @@
+#ifndef STD140_C
+#define STD140_C
+
+#include <type_traits>
+
+#include "Matrix.h"
+
+/**
+ * vec3 with the std140 layout: aligned to 16 bytes, the last float is
+ * padding. Arrays of PaddedVec3f have the stride of std140 vec3 arrays,
+ * unlike Vec3f which is tightly packed (12 bytes) for vertex data.
+ */
+struct alignas(16) PaddedVec3f {
+  float x{0.0f};
+  float y{0.0f};
+  float z{0.0f};
+  float padding{0.0f};
+
+  constexpr PaddedVec3f() = default;
+  constexpr PaddedVec3f(const Vec3f &v) : x{v(0)}, y{v(1)}, z{v(2)} {};
+  constexpr Vec3f toVec3f() const { return Vec3f{x, y, z}; }
+  constexpr const float *data() const { return &x; }
+  constexpr bool operator==(const PaddedVec3f &v) const = default;
+};
+
+static_assert(sizeof(PaddedVec3f) == 16 && alignof(PaddedVec3f) == 16);
+
+/**
+ * Structs of std140 compatible members laid out like the matching GLSL
+ * block struct, padding included, opt in by specializing this to true next
+ * to their definition.
+ */
+template <typename T> constexpr bool std140Struct = false;
+
+/**
+ * Types whose memory layout is the std140 one, arrays included: contiguous
+ * arrays of them can be copied into uniform (or vertex) buffers as they
+ * are, without repacking. Mat3f and Vec3f are not, std140 pads their
+ * columns to 16 bytes.
+ */
+template <typename T>
+concept Std140Compatible =
+    std::is_standard_layout_v<T> &&
+    (std::is_same_v<T, int> || std::is_same_v<T, unsigned int> ||
+     std::is_same_v<T, float> || std::is_same_v<T, Vec4f> ||
+     std::is_same_v<T, Mat4f> || std::is_same_v<T, PaddedVec3f> ||
+     std140Struct<T>);
+
+static_assert(Std140Compatible<Mat4f> && Std140Compatible<Vec4f>);
+
+#endif // STD140_C
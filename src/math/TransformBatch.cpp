@@ -0,0 +1,37 @@
+#include "TransformBatch.h"
+
+#include <cassert>
+
+void TransformBatch::clear() {
+  for (auto *v : {&px, &py, &pz, &scale, &qw, &qx, &qy, &qz}) {
+    v->clear();
+  }
+}
+
+void TransformBatch::reserve(std::size_t n) {
+  for (auto *v : {&px, &py, &pz, &scale, &qw, &qx, &qy, &qz}) {
+    v->reserve(n);
+  }
+}
+
+void TransformBatch::push_back(const Vec3f &position, float scale,
+                               const Quatf &rotation) {
+  px.push_back(position(0));
+  py.push_back(position(1));
+  pz.push_back(position(2));
+  this->scale.push_back(scale);
+  qw.push_back(rotation.w);
+  qx.push_back(rotation.x);
+  qy.push_back(rotation.y);
+  qz.push_back(rotation.z);
+}
+
+void TransformBatch::computeModelMatrices(std::span<Mat4f> out) {
+  const std::size_t n = size();
+  assert(out.size() >= n);
+  if (n == 0)
+    return;
+  simd::TransformSoA soa{px.data(), py.data(), pz.data(), scale.data(),
+                         qw.data(), qx.data(), qy.data(), qz.data(), n};
+  simd::kernels().buildModelMatrices(soa, out.data()->data().data());
+}
@@ -0,0 +1,43 @@
+#ifndef TRANSFORM_BATCH_C
+#define TRANSFORM_BATCH_C
+
+#include <span>
+
+#include "AlignedAllocator.h"
+#include "Matrix.h"
+#include "Quaternion.h"
+
+static_assert(sizeof(Mat4f) == 16 * sizeof(float),
+              "Mat4f arrays must be contiguous arrays of floats");
+
+/**
+ * Structure of arrays description of the transforms of many entities.
+ * It builds all the model matrices in one vectorized pass instead of
+ * composing translate, scale and rotate entity by entity.
+ */
+class TransformBatch {
+public:
+  void clear();
+  void reserve(std::size_t n);
+  std::size_t size() const { return px.size(); }
+  /**
+   * Append the transform of an entity
+   * @param position - translation
+   * @param scale - uniform scaling factor
+   * @param rotation - unit quaternion
+   */
+  void push_back(const Vec3f &position, float scale, const Quatf &rotation);
+  /**
+   * out[i] = translate(position_i) * scale_i * rotation_i.toMat4(),
+   * the same matrix returned by mat::modelMatrix.
+   * @param out - output array, at least size() elements
+   */
+  void computeModelMatrices(std::span<Mat4f> out);
+
+private:
+  AlignedVector<float> px, py, pz;
+  AlignedVector<float> scale;
+  AlignedVector<float> qw, qx, qy, qz;
+};
+
+#endif // TRANSFORM_BATCH_C
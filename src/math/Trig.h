@@ -0,0 +1,76 @@
+#ifndef TRIG_C
+#define TRIG_C
+
+#include <array>
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ConstexprMath.h"
+#include "MatrixSimd.h"
+
+namespace mat {
+/**
+ * sin and cos of the same angle. At runtime floats use the polynomial of
+ * simd::reference::sincos (max absolute error 1.2e-7 for
+ * |x| <= simd::reference::SINCOS_MAX_ANGLE), the other types and constant
+ * expressions use constmath.
+ */
+template <typename T>
+  requires std::is_floating_point_v<T>
+constexpr void sincos(T x, T &s, T &c) {
+  if consteval {
+    s = constmath::sin(x);
+    c = constmath::cos(x);
+  } else {
+    if constexpr (std::is_same_v<T, float>) {
+      simd::reference::sincos(x, s, c);
+    } else {
+      s = std::sin(x);
+      c = std::cos(x);
+    }
+  }
+}
+
+/**
+ * sin and cos of a batch of angles, vectorized with the kernels of the
+ * running CPU. Results are bit-identical to the scalar mat::sincos.
+ * s and c must have the same size of x.
+ */
+inline void sincos(std::span<const float> x, std::span<float> s,
+                   std::span<float> c) {
+  if (s.size() != x.size() || c.size() != x.size()) {
+    throw std::runtime_error("sincos output size mismatch");
+  }
+  simd::kernels().sincos(x.data(), x.size(), s.data(), c.data());
+}
+
+/**
+ * sin and cos of the Steps angles 2*pi*i/Steps generated at compile time,
+ * for angles that move in fixed steps. A lookup costs a load and is as
+ * accurate as constmath.
+ */
+template <std::size_t Steps> class SinCosTable {
+public:
+  static constexpr float step = 2.0 * std::numbers::pi / Steps;
+
+  consteval SinCosTable() {
+    for (std::size_t i = 0; i < Steps; i++) {
+      double angle = 2.0 * std::numbers::pi * i / Steps;
+      sinTable[i] = static_cast<float>(constmath::sin(angle));
+      cosTable[i] = static_cast<float>(constmath::cos(angle));
+    }
+  }
+  // Values of the angle i * step, i is taken modulo Steps
+  constexpr float sin(std::size_t i) const { return sinTable[i % Steps]; }
+  constexpr float cos(std::size_t i) const { return cosTable[i % Steps]; }
+
+private:
+  std::array<float, Steps> sinTable{};
+  std::array<float, Steps> cosTable{};
+};
+} // namespace mat
+
+#endif // TRIG_C
@@ -0,0 +1,88 @@
+#ifndef COMPONENTS_C
+#define COMPONENTS_C
+
+#include <cstdint>
+
+#include "../ecs/World.h"
+#include "../math/Matrix.h"
+#include "../math/Quaternion.h"
+
+// Components of the entities stored by the EntityManager
+
+/**
+ * Transform relative to the parent (to the world for root entities).
+ * The setters keep track of the changes, so that only the entities that
+ * moved are updated. Positions are double precision to keep large worlds
+ * jitter free.
+ */
+class Transform {
+public:
+  Transform(Vec3d position = Vec3d(), float scale = 1.0f,
+            Quatf rotation = Quatf())
+      : position{std::move(position)}, rotation{rotation}, scale{scale} {};
+
+  void setPosition(Vec3d newPosition) {
+    position = std::move(newPosition);
+    dirty = true;
+  }
+  const Vec3d &getPosition() const { return position; }
+  void setRotation(const Quatf &newRotation) {
+    rotation = newRotation;
+    dirty = true;
+  }
+  const Quatf &getRotation() const { return rotation; }
+  void setScale(float newScale) {
+    scale = newScale;
+    dirty = true;
+  }
+  float getScale() const { return scale; }
+
+  // The transform changed since the last clearDirty
+  bool isDirty() const { return dirty; }
+  void clearDirty() { dirty = false; }
+
+private:
+  Vec3d position;
+  Quatf rotation;
+  float scale;
+  bool dirty = true;
+};
+
+struct Velocity {
+  Vec3f linear = Vec3f();
+  // Rotation axis * radians/second, world frame
+  Vec3f angular = Vec3f();
+};
+
+// Moves the transform by the velocity over deltaTime seconds. The transform
+// changes only if the entity is actually moving
+inline void integrate(Transform &transform, const Velocity &velocity,
+                      float deltaTime) {
+  if (velocity.linear != Vec3f()) {
+    transform.setPosition(transform.getPosition() +
+                          Vec3f{velocity.linear * deltaTime}.cast<double>());
+  }
+  if (velocity.angular != Vec3f()) {
+    Quatf rotation = transform.getRotation();
+    rotation.integrate(velocity.angular, deltaTime);
+    transform.setRotation(rotation);
+  }
+}
+
+// Model drawn by the entity, id given by EntityManager::addModel
+struct Renderable {
+  std::uint32_t model;
+};
+
+// Position of the entity in the transform hierarchy
+struct SceneNode {
+  // Node of the scene graph, also index of the per node arrays
+  std::uint32_t node;
+  ecs::EntityId parent = ecs::NO_ENTITY;
+};
+
+// Tag of the entities that are transparent or partially transparent,
+// for example a window
+struct Transparent {};
+
+#endif // COMPONENTS_C
@@ -0,0 +1,229 @@
+#include "DeferredRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "../math/Frustum.h"
+#include "../math/MatrixUtils.h"
+
+static constexpr ColorFormat G_BUFFER_FORMATS[] = {
+    // LIT_COLOR, HDR until post processing
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT},
+    // ALBEDO_SPECULAR, linear colors need more than 8 bits
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT},
+    // NORMAL
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT},
+    // DISTANCE
+    {GL_R32F, GL_RED, GL_FLOAT}};
+
+static float dot(const Vec3f &a, const Vec3f &b) {
+  return a(0) * b(0) + a(1) * b(1) + a(2) * b(2);
+}
+
+/**
+ * Icosahedron containing the unit sphere: its faces, not its vertices, are
+ * at distance >= 1 from the center. Faces are counter clockwise seen from
+ * outside
+ */
+static Mesh makeLightVolume() {
+  const float phi = (1.0f + std::sqrt(5.0f)) / 2.0f;
+  // Cyclic permutations of (0, +-1, +-phi)
+  std::vector<Vec3f> points;
+  for (int axis = 0; axis < 3; axis++) {
+    for (float a : {-1.0f, 1.0f}) {
+      for (float b : {-phi, phi}) {
+        Vec3f p{0.0f, 0.0f, 0.0f};
+        p((axis + 1) % 3) = a;
+        p((axis + 2) % 3) = b;
+        points.push_back(std::move(p));
+      }
+    }
+  }
+  // Faces are the triples of vertices at edge distance (2) from each other
+  std::vector<unsigned int> indices;
+  float inradius = std::numeric_limits<float>::max();
+  auto adjacent = [&](std::size_t i, std::size_t j) {
+    return std::abs(mat::distance2(points[i], points[j]) - 4.0f) < 1e-3f;
+  };
+  for (unsigned int i = 0; i < points.size(); i++) {
+    for (unsigned int j = i + 1; j < points.size(); j++) {
+      for (unsigned int k = j + 1; k < points.size(); k++) {
+        if (!adjacent(i, j) || !adjacent(j, k) || !adjacent(i, k))
+          continue;
+        Vec3f normal =
+            mat::cross(points[j] - points[i], points[k] - points[i]);
+        const bool outward = dot(normal, points[i]) > 0.0f;
+        indices.insert(indices.end(), {i, outward ? j : k, outward ? k : j});
+        inradius = std::min(
+            inradius, std::abs(dot(normal, points[i])) / normal.norm());
+      }
+    }
+  }
+  std::vector<Vertex> vertices;
+  for (const Vec3f &p : points) {
+    vertices.push_back(
+        Vertex{{p(0) / inradius, p(1) / inradius, p(2) / inradius}, {}, {}});
+  }
+  return Mesh{vertices, indices};
+}
+
+DeferredRenderer::DeferredRenderer(float width, float height)
+    : width{width}, height{height}, gBuffer{width, height, G_BUFFER_FORMATS},
+      lightVolume{makeLightVolume()}, screenQuad{Mesh::screenQuad()} {
+  lightShader.use();
+  lightShader.setGBuffer(0, 1, 2);
+}
+
+void DeferredRenderer::beginGeometryPass(const Camera &camera) {
+  static constexpr unsigned int ALL[] = {LIT_COLOR, ALBEDO_SPECULAR, NORMAL,
+                                         DISTANCE};
+  static constexpr unsigned int MATERIAL[] = {ALBEDO_SPECULAR, NORMAL,
+                                              DISTANCE};
+  static constexpr GLfloat OPAQUE_BLACK[] = {0.0f, 0.0f, 0.0f, 1.0f};
+  static constexpr GLfloat ZERO[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  gBuffer.setDrawBuffers(ALL);
+  GLState &state = GLState::get();
+  state.depthMask(true);
+  glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  // The lit color is opaque like the screen, the material data of the
+  // background is 0
+  glClearBufferfv(GL_COLOR, LIT_COLOR, OPAQUE_BLACK);
+  for (unsigned int attachment : MATERIAL) {
+    glClearBufferfv(GL_COLOR, attachment, ZERO);
+  }
+  gBuffer.setDrawBuffers(MATERIAL);
+  // Blending would mix the material data of different surfaces
+  state.disable(GL_BLEND);
+  state.enable(GL_DEPTH_TEST);
+  geometryShader.use();
+  geometryShader.setPvMatrix(camera.getProjectionMatrix() *
+                             camera.getViewMatrix());
+}
+
+void DeferredRenderer::scissorRect(const Mat4f &pvMatrix, const Vec3f &center,
+                                   float radius, GLint rect[4]) const {
+  float min[2] = {1.0f, 1.0f};
+  float max[2] = {-1.0f, -1.0f};
+  // The projection of the bounding box is the hull of its corners, as long
+  // as all of them are in front of the eye
+  for (int corner = 0; corner < 8; corner++) {
+    Vec4f p{center(0) + (corner & 1 ? radius : -radius),
+            center(1) + (corner & 2 ? radius : -radius),
+            center(2) + (corner & 4 ? radius : -radius), 1.0f};
+    Vec4f clip = pvMatrix * p;
+    if (clip(3) <= 0.0f) {
+      min[0] = min[1] = -1.0f;
+      max[0] = max[1] = 1.0f;
+      break;
+    }
+    for (int i = 0; i < 2; i++) {
+      min[i] = std::min(min[i], clip(i) / clip(3));
+      max[i] = std::max(max[i], clip(i) / clip(3));
+    }
+  }
+  const float size[2] = {width, height};
+  for (int i = 0; i < 2; i++) {
+    float first =
+        std::floor((std::max(min[i], -1.0f) * 0.5f + 0.5f) * size[i]);
+    float last = std::ceil((std::min(max[i], 1.0f) * 0.5f + 0.5f) * size[i]);
+    rect[i] = first;
+    rect[i + 2] = std::max(last - first, 0.0f);
+  }
+}
+
+void DeferredRenderer::lightingPass(const Camera &camera,
+                                    const DirectionalLight *dirLight,
+                                    std::span<const PointLightVolume> lights) {
+  static constexpr unsigned int LIT[] = {LIT_COLOR};
+  gBuffer.setDrawBuffers(LIT);
+  GLState &state = GLState::get();
+  for (int unit = 0; unit < 3; unit++) {
+    state.activeTexture(unit);
+    gBuffer.bindColor(ALBEDO_SPECULAR + unit);
+  }
+  const Mat4f pvMatrix = camera.getProjectionMatrix() * camera.getViewMatrix();
+  lightShader.use();
+  lightShader.setInversePV(mat::inverse(pvMatrix));
+  // Lights add up
+  state.enable(GL_BLEND);
+  state.blendFunc(GL_ONE, GL_ONE);
+  state.depthMask(false);
+
+  // Step 1 - Lights of the whole screen
+  state.disable(GL_DEPTH_TEST);
+  if (dirLight) {
+    lightShader.setDirectionalLight(*dirLight);
+    screenQuad.render();
+  }
+  for (const PointLightVolume &volume : lights) {
+    if (!std::isfinite(volume.radius)) {
+      lightShader.setUnboundedLight(*volume.light, volume.position);
+      screenQuad.render();
+    }
+  }
+
+  // Step 2 - Light volumes, inside the scissor rectangle of their sphere
+  state.enable(GL_STENCIL_TEST);
+  state.enable(GL_SCISSOR_TEST);
+  Frustum frustum{pvMatrix};
+  litCount = 0;
+  for (const PointLightVolume &volume : lights) {
+    if (!std::isfinite(volume.radius) ||
+        !frustum.intersectsSphere(volume.position, volume.radius))
+      continue;
+    GLint rect[4];
+    scissorRect(pvMatrix, volume.position, volume.radius, rect);
+    if (rect[2] == 0 || rect[3] == 0)
+      continue;
+    glScissor(rect[0], rect[1], rect[2], rect[3]);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    const Mat4f pvm =
+        pvMatrix * mat::translate(volume.position) *
+        mat::scale(Vec3f{volume.radius, volume.radius, volume.radius});
+
+    // Stencil pass: surfaces in front of the back faces and behind the
+    // front faces are inside the volume and end up with a non zero value
+    stencilShader.use();
+    stencilShader.setPvmMatrix(pvm);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    state.enable(GL_DEPTH_TEST);
+    state.disable(GL_CULL_FACE);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+    lightVolume.render();
+
+    // Shading pass: back faces, so the volume is drawn even with the
+    // camera inside it
+    lightShader.use();
+    lightShader.setPointLight(*volume.light, volume.position, volume.radius,
+                              pvm);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    state.disable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    lightVolume.render();
+    litCount++;
+  }
+
+  // Default state of the forward passes
+  state.disable(GL_STENCIL_TEST);
+  state.disable(GL_SCISSOR_TEST);
+  state.disable(GL_CULL_FACE);
+  glCullFace(GL_BACK);
+  state.enable(GL_DEPTH_TEST);
+  state.depthMask(true);
+  state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void DeferredRenderer::beginForwardPass() {
+  static constexpr unsigned int LIT[] = {LIT_COLOR};
+  gBuffer.setDrawBuffers(LIT);
+  GLState &state = GLState::get();
+  state.enable(GL_BLEND);
+  state.enable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,82 @@
+#ifndef DEFERRED_RENDERER_C
+#define DEFERRED_RENDERER_C
+
+#include <span>
+
+#include "../Camera.h"
+#include "../buffer/FrameBuffer.h"
+#include "../shaders/deferred/DeferredLightShader.h"
+#include "../shaders/deferred/GBufferShader.h"
+#include "../shaders/light_source/LightShader.h"
+#include "Light.h"
+#include "Model.h"
+
+/**
+ * Deferred shading pipeline. The geometry pass writes the material data of
+ * the closest surfaces in the G-buffer, then the lighting pass draws a
+ * volume for each point light: a stencil pass marks the pixels whose
+ * surface is inside the volume, and only those are shaded. Lighting cost
+ * scales with the lit pixels instead of entities x lights.
+ * Forward passes (transparent entities, light models) are drawn after the
+ * lighting into the lit color, depth tested against the G-buffer.
+ */
+class DeferredRenderer {
+public:
+  // Color attachments of the G-buffer
+  enum Attachment : unsigned int {
+    // Result of the lighting and forward passes
+    LIT_COLOR = 0,
+    // Albedo and single channel specular intensity
+    ALBEDO_SPECULAR,
+    NORMAL,
+    // Distance from the camera, 0 for the background
+    DISTANCE
+  };
+  struct PointLightVolume {
+    const PointLight *light;
+    // Camera relative
+    Vec3f position;
+    float radius;
+  };
+
+  DeferredRenderer(float width, float height);
+  // Shader of the geometry pass, in use after beginGeometryPass
+  GBufferShader &getGeometryShader() { return geometryShader; }
+  // Clear the G-buffer and bind it for the geometry pass
+  void beginGeometryPass(const Camera &camera);
+  /**
+   * Add the lights to the lit color. Lights with an infinite radius shade
+   * the whole screen like the directional one
+   * @param dirLight - nullptr if there is none
+   */
+  void lightingPass(const Camera &camera, const DirectionalLight *dirLight,
+                    std::span<const PointLightVolume> lights);
+  // Bind the lit color for forward draws
+  void beginForwardPass();
+  // Bind the lit color texture, for post processing
+  void bindLitColor() const { gBuffer.bindColor(LIT_COLOR); }
+  // Light volumes drawn by the last lighting pass, the others were culled
+  std::size_t getLitCount() const { return litCount; }
+
+private:
+  float width;
+  float height;
+  FrameBuffer gBuffer;
+  GBufferShader geometryShader;
+  DeferredLightShader lightShader;
+  // Only writes the depth and stencil tests of the light volumes
+  LightShader stencilShader;
+  Mesh lightVolume;
+  Mesh screenQuad;
+  std::size_t litCount = 0;
+
+  /**
+   * Pixels that can be covered by a sphere, the whole screen if the sphere
+   * crosses the near plane
+   * @param rect - x, y, width, height
+   */
+  void scissorRect(const Mat4f &pvMatrix, const Vec3f &center, float radius,
+                   GLint rect[4]) const;
+};
+
+#endif // DEFERRED_RENDERER_C
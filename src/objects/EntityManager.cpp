@@ -1,83 +1,552 @@
 #include "EntityManager.h"
 
+#include <stdexcept>
+
+std::uint32_t EntityManager::addModel(Model model) {
+  const std::uint32_t id = models.size();
+  for (std::uint32_t material = 0; material < model.getMaterialCount();
+       material++) {
+    for (std::uint32_t i = 0; i < model.getMeshes(material).size(); i++) {
+      meshEntries.push_back(MeshEntry{id, material, materialCount, i});
+    }
+    materialCount++;
+  }
+  modelFirstMesh.push_back(meshEntries.size());
+  models.push_back(std::move(model));
+  modelInstances.emplace_back();
+  return id;
+}
+
+template <typename... Cs>
+ecs::EntityId EntityManager::createEntity(std::uint32_t model,
+                                          Transform transform,
+                                          Cs &&...components) {
+  if (model >= models.size()) {
+    throw std::runtime_error("Entity with an unknown model");
+  }
+  const std::uint32_t node = nodeEntities.size();
+  ecs::EntityId id = world.create(std::move(transform), Velocity{},
+                                  Renderable{model}, SceneNode{node},
+                                  std::forward<Cs>(components)...);
+  nodeEntities.push_back(id);
+  nodeModels.push_back(model);
+  hierarchyDirty = true;
+  return id;
+}
+
+ecs::EntityId EntityManager::addSolidEntity(std::uint32_t model,
+                                            Transform transform) {
+  return createEntity(model, std::move(transform));
+}
+
+ecs::EntityId EntityManager::addTransparentEntity(std::uint32_t model,
+                                                  Transform transform) {
+  return createEntity(model, std::move(transform), Transparent{});
+}
+
+ecs::EntityId EntityManager::addPointLight(std::uint32_t model,
+                                           PointLight light,
+                                           Transform transform) {
+  return createEntity(model, std::move(transform), std::move(light));
+}
+
+void EntityManager::setDirectionalLight(DirectionalLight *source) {
+  dirLight = source;
+}
+
+void EntityManager::setParent(ecs::EntityId child, ecs::EntityId parent) {
+  if (parent != ecs::NO_ENTITY && !world.has<SceneNode>(parent)) {
+    throw std::runtime_error("Parent entity not added to the EntityManager");
+  }
+  world.get<SceneNode>(child).parent = parent;
+  hierarchyDirty = true;
+}
+
 void EntityManager::update(float deltaTime) {
-  iterEntities([&](Entity *e) { e->update(deltaTime); }, true);
+  world.query<Transform, const Velocity>().eachArchetype(
+      [&](std::span<const ecs::EntityId>, std::span<Transform> transforms,
+          std::span<const Velocity> velocities) {
+        jobSystem.parallelFor(
+            transforms.size(), UPDATE_CHUNK,
+            [&](std::size_t begin, std::size_t end) {
+              for (std::size_t i = begin; i < end; i++) {
+                integrate(transforms[i], velocities[i], deltaTime);
+              }
+            });
+      });
 }
 
 void EntityManager::render(const Camera &camera) {
-  renderLights(camera);
-  renderEntities(camera);
+  updateTransforms();
+  rebaseOrigin(camera.getCameraPos());
+  cullEntities(camera);
+  gatherLights(camera);
+  renderStats = RenderQueue::Stats{};
+  usedInstanceBuffers = 0;
+  if (deferredRenderer) {
+    renderDeferred(camera);
+  } else {
+    renderForward(camera, true);
+  }
+}
+
+void EntityManager::rebuildSceneGraph() {
+  const std::size_t n = nodeEntities.size();
+  std::vector<std::uint32_t> parents(n, SceneGraph::NO_PARENT);
+  world.query<const SceneNode>().each([&](const SceneNode &sceneNode) {
+    if (sceneNode.parent != ecs::NO_ENTITY) {
+      parents[sceneNode.node] = world.get<SceneNode>(sceneNode.parent).node;
+    }
+  });
+  sceneGraph.build(parents);
+  worldBounds.resize(n);
+  boundingSpheres.resize(n);
+  nodeFrameLight.resize(n);
+  normalMatrices.resize(n);
+  normalDirty.assign(n, 1);
 }
 
-void EntityManager::renderLights(const Camera &camera) {
-  lightShader.use();
-  Mat4f pvMatrix = camera.getProjectionMatrix() * camera.getViewMatrix();
-  for (const PointLight *light : lights) {
-    lightShader.setLightColor(light->lightColor);
-    lightShader.setPvmMatrix(pvMatrix * light->modelMatrix());
-    light->render(lightShader);
+// Largest scaling factor of an affine transformation
+static float maxScale(const Mat4f &m) {
+  float res = 0.0f;
+  for (int j = 0; j < 3; j++) {
+    res = std::max(res, m(0, j) * m(0, j) + m(1, j) * m(1, j) +
+                            m(2, j) * m(2, j));
   }
+  return std::sqrt(res);
+}
+
+void EntityManager::updateTransforms() {
+  const bool rebuild = hierarchyDirty;
+  if (rebuild) {
+    rebuildSceneGraph();
+    hierarchyDirty = false;
+  }
+
+  // Step 1 - Local matrices of the entities that moved, in a batched pass.
+  // Translations are applied in double precision by the scene graph
+  transformBatch.clear();
+  dirtyEntities.clear();
+  world.query<Transform, const SceneNode>().each(
+      [&](Transform &transform, const SceneNode &sceneNode) {
+        if (rebuild || transform.isDirty()) {
+          transformBatch.push_back(Vec3f(), transform.getScale(),
+                                   transform.getRotation());
+          dirtyEntities.push_back(std::pair(sceneNode.node, &transform));
+        }
+      });
+  if (!dirtyEntities.empty()) {
+    localMatrices.resize(transformBatch.size());
+    transformBatch.computeModelMatrices(localMatrices);
+    for (const auto &[k, entry] : std::views::enumerate(dirtyEntities)) {
+      const auto &[node, transform] = entry;
+      sceneGraph.setLocalTransform(node, localMatrices[k],
+                                   transform->getPosition());
+      transform->clearDirty();
+    }
+  }
+
+  // Step 2 - World transforms and bounding spheres of the dirty subtrees,
+  // static scenes have nothing to update
+  for (std::uint32_t node : sceneGraph.propagate()) {
+    normalDirty[node] = 1;
+    updateBoundingSphere(node);
+  }
+}
+
+void EntityManager::updateBoundingSphere(std::uint32_t node) {
+  const Bounds &bounds = models[nodeModels[node]].getBounds();
+  const Mat4f &worldMatrix = sceneGraph.getWorldMatrix(node);
+  Vec3d center = Vec3f{bounds.center[0], bounds.center[1], bounds.center[2]}
+                     .cast<double>();
+  WorldSphere &sphere = worldBounds[node];
+  sphere.center = sceneGraph.getWorldPosition(node) +
+                  mat::transformDirection(worldMatrix, center);
+  sphere.radius = bounds.radius * maxScale(worldMatrix);
+  boundingSpheres.set(node,
+                      mat::relativePosition(sphere.center, cullingOrigin),
+                      sphere.radius);
+}
+
+void EntityManager::rebaseOrigin(const Vec3d &cameraPos) {
+  if (rebaseDistance <= 0.0 ||
+      mat::distance2(cameraPos, cullingOrigin) <=
+          rebaseDistance * rebaseDistance) {
+    return;
+  }
+  cullingOrigin = cameraPos.clone();
+  for (std::uint32_t node = 0; node < nodeEntities.size(); node++) {
+    const WorldSphere &sphere = worldBounds[node];
+    boundingSpheres.set(node,
+                        mat::relativePosition(sphere.center, cullingOrigin),
+                        sphere.radius);
+  }
+}
+
+void EntityManager::cullEntities(const Camera &camera) {
+  // The spheres are relative to cullingOrigin, move it in the camera
+  Mat4f toCamera = mat::translate(
+      mat::relativePosition(cullingOrigin, camera.getCameraPos()));
+  Frustum frustum{camera.getProjectionMatrix() * camera.getViewMatrix() *
+                  toCamera};
+  std::span<const std::uint32_t> visible = boundingSpheres.cull(frustum);
+  visibleNodes.assign(nodeEntities.size(), 0);
+  for (std::uint32_t node : visible) {
+    visibleNodes[node] = 1;
+  }
+  culledCount = boundingSpheres.size() - visible.size();
+}
+
+Mat4f EntityManager::modelMatrix(std::uint32_t node,
+                                 const Vec3d &origin) const {
+  Mat4f res = sceneGraph.getWorldMatrix(node).clone();
+  Vec3f translation =
+      mat::relativePosition(sceneGraph.getWorldPosition(node), origin);
+  for (int i = 0; i < 3; i++) {
+    res(i, 3) = translation(i);
+  }
+  return res;
+}
+
+const Mat3f &EntityManager::normalMatrix(std::uint32_t node) {
+  if (normalDirty[node]) {
+    normalMatrices[node] = mat::normalMatrix(sceneGraph.getWorldMatrix(node));
+    normalDirty[node] = 0;
+  }
+  return normalMatrices[node];
+}
+
+bool EntityManager::useClusters(const Camera &camera) const {
+  return lightAssignment == LightAssignment::CLUSTERED &&
+         LightClusters::isPerspective(camera.getProjectionMatrix());
+}
+
+void EntityManager::gatherLights(const Camera &camera) {
+  const bool perEntity = !useClusters(camera);
+  const Vec3d &cameraPos = camera.getCameraPos();
+  frameLights.clear();
+  world.query<const PointLight, const SceneNode>().each(
+      [&](const PointLight &light, const SceneNode &sceneNode) {
+        // Lights outside the frustum can still light visible entities
+        const Vec3d &position = sceneGraph.getWorldPosition(sceneNode.node);
+        if (perEntity) {
+          lightGrid.set(sceneNode.node, position, light.getRadius());
+        }
+        nodeFrameLight[sceneNode.node] = frameLights.size();
+        frameLights.push_back(
+            FrameLight{&light, mat::relativePosition(position, cameraPos)});
+      });
 }
 
-void EntityManager::renderEntities(const Camera &camera) {
+void EntityManager::queueLights(const Camera &camera) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  world.query<const PointLight, const SceneNode>().each(
+      [&](const PointLight &light, const SceneNode &sceneNode) {
+        if (visibleNodes[sceneNode.node]) {
+          addInstance(sceneNode.node, cameraPos).setColor(light.lightColor);
+        }
+      });
+  queueInstances(LIGHT_PASS, LIGHT_INSTANCES);
+}
+
+static Vec4f withW(const Vec3f &v, float w) {
+  return Vec4f{v(0), v(1), v(2), w};
+}
+
+void EntityManager::clusterLights(const Camera &camera) {
+  clusterSpheres.clear();
+  clusterLightData.clear();
+  for (const FrameLight &frameLight : frameLights) {
+    const PointLight &light = *frameLight.light;
+    const Vec3f &position = frameLight.position;
+    const Vec3f &attenuation = light.attenuationCoefficients;
+    Vec4f sphere = withW(position, light.getRadius());
+    // Texels of phong_light.fs
+    clusterLightData.push_back(sphere.clone());
+    clusterLightData.push_back(withW(light.ambientIntensity, attenuation(0)));
+    clusterLightData.push_back(withW(light.diffuseIntensity, attenuation(1)));
+    clusterLightData.push_back(withW(light.specularIntensity, attenuation(2)));
+    clusterSpheres.push_back(std::move(sphere));
+  }
+  lightClusters.setProjection(camera.getProjectionMatrix());
+  lightClusters.build(camera.getViewMatrix(), clusterSpheres);
+  entityShader.setClusteredLights(lightClusters, clusterLightData);
+}
+
+bool EntityManager::useEntityShader(const Camera &camera) {
   entityShader.use();
   entityShader.setCamera(camera);
-  // Step 1 - Draw all solid Entities
-  for (const Entity *entity : solidEntities) {
-    renderEntity(entity);
+  const bool clustered = useClusters(camera);
+  if (clustered) {
+    clusterLights(camera);
+  } else {
+    entityShader.disableClusteredLights();
+  }
+  // Light block: the directional light then, for the lights by entity, the
+  // point lights in the order of frameLights
+  lightData.clear();
+  if (dirLight) {
+    lightData.push_back(LightData::directional(*dirLight));
+  }
+  if (!clustered) {
+    for (const FrameLight &frameLight : frameLights) {
+      if (lightData.size() == EntityShader::MAX_LIGHTS)
+        break;
+      lightData.push_back(
+          LightData::point(*frameLight.light, frameLight.position));
+    }
+  }
+  entityShader.setLights(lightData);
+  return clustered;
+}
+
+template <typename F> void EntityManager::eachVisibleSolid(F &&function) {
+  world.query<const SceneNode>()
+      .without<Transparent, PointLight>()
+      .each([&](const SceneNode &sceneNode) {
+        if (visibleNodes[sceneNode.node]) {
+          function(sceneNode.node);
+        }
+      });
+}
+
+void EntityManager::queueSolidEntities(const Camera &camera, bool clustered) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  if (clustered) {
+    eachVisibleSolid([&](std::uint32_t node) { addInstance(node, cameraPos); });
+    queueInstances(SOLID_PASS, ENTITY_INSTANCES);
+    return;
+  }
+  eachVisibleSolid([&](std::uint32_t node) {
+    queueEntity(node, SOLID_PASS, cameraPos);
+  });
+}
+
+void EntityManager::queueTransparentEntities(const Camera &camera,
+                                             bool clustered) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  // Any order works with weighted blended transparency, the queue sorts
+  // them by state
+  world.query<const SceneNode, const Transparent>().each(
+      [&](const SceneNode &sceneNode, const Transparent &) {
+        if (!visibleNodes[sceneNode.node])
+          return;
+        if (clustered) {
+          addInstance(sceneNode.node, cameraPos);
+        } else {
+          queueEntity(sceneNode.node, TRANSPARENT_PASS, cameraPos);
+        }
+      });
+  if (clustered) {
+    queueInstances(TRANSPARENT_PASS, ENTITY_INSTANCES);
+  }
+}
+
+void EntityManager::renderSortedTransparent(const Camera &camera,
+                                            bool clustered) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  // Step 1 - Sort visible transparent entities based on their distance
+  // from the camera
+  transparentQueue.clear();
+  world.query<const SceneNode, const Transparent>().each(
+      [&](const SceneNode &sceneNode, const Transparent &) {
+        if (!visibleNodes[sceneNode.node])
+          return;
+        double d = mat::distance2(sceneGraph.getWorldPosition(sceneNode.node),
+                                  cameraPos);
+        transparentQueue.push(sceneNode.node, d);
+      });
+  // Step 2 - Display transparent entities from furthest to closest, the
+  // order matters more than the binds
+  entityShader.use();
+  entityShader.setInstanced(false);
+  for (std::uint32_t node : transparentQueue.sort()) {
+    setEntityUniforms(node, cameraPos, clustered);
+    models[nodeModels[node]].render(entityShader);
+  }
+}
+
+void EntityManager::renderForward(const Camera &camera, bool solids) {
+  const bool clustered = useEntityShader(camera);
+  queueLights(camera);
+  if (solids) {
+    queueSolidEntities(camera, clustered);
+  }
+  if (weightedBlendedOIT) {
+    queueTransparentEntities(camera, clustered);
   }
-  // Step 2 - Sort transparent entities based on their distance from the camera
-  std::map<float, const Entity *> sortedEntities;
-  for (const Entity *entity : transparentEntities) {
-    float d = mat::distance2(entity->position, camera.getCameraPos());
-    sortedEntities.insert(std::pair(d, entity));
+  drawQueue(camera, clustered);
+  if (!weightedBlendedOIT) {
+    renderSortedTransparent(camera, clustered);
   }
-  // Step 3 - Display transparent entities from furthest to closest
-  for (auto it = sortedEntities.rbegin(); it != sortedEntities.rend(); it++) {
-    renderEntity(it->second);
+}
+
+void EntityManager::renderDeferred(const Camera &camera) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  // Step 1 - Material data of the solid entities
+  deferredRenderer->beginGeometryPass(camera);
+  eachVisibleSolid([&](std::uint32_t node) { addInstance(node, cameraPos); });
+  queueInstances(SOLID_PASS, GEOMETRY_INSTANCES);
+  drawQueue(camera, false);
+  // Step 2 - Light volumes
+  lightVolumes.clear();
+  for (const FrameLight &frameLight : frameLights) {
+    lightVolumes.push_back(DeferredRenderer::PointLightVolume{
+        frameLight.light, frameLight.position.clone(),
+        frameLight.light->getRadius()});
   }
-  // TODO: implement an order independent algorithm
-  // https://en.wikipedia.org/wiki/Order-independent_transparency
+  deferredRenderer->lightingPass(camera, dirLight, lightVolumes);
+  // Step 3 - Forward shading of what the G-buffer can't store
+  deferredRenderer->beginForwardPass();
+  renderForward(camera, false);
 }
 
-void EntityManager::renderEntity(const Entity *entity) {
-  // Update light positions in the entity shader
-  entityShader.setModelMatrix(entity->modelMatrix());
-  size_t found = 0;
-  // Find which light are close enough to have an effect
+void EntityManager::setEntityUniforms(std::uint32_t node,
+                                      const Vec3d &cameraPos, bool clustered) {
+  entityShader.setModelMatrix(modelMatrix(node, cameraPos));
+  entityShader.setNormalMatrix(normalMatrix(node));
+  entityLights.clear();
   if (dirLight) {
-    entityShader.setDirectionalLight(*dirLight, found);
-    found += 1;
+    entityLights.push_back(0);
   }
-  for (PointLight *light : this->lights) {
-    if (mat::distance2(light->position, entity->position) < LIGHT_D2_CUTOFF) {
-      entityShader.setPointLight(*light, found);
-      found += 1;
+  // Find which light are close enough to have an effect, clustered point
+  // lights are found by the shader
+  if (!clustered) {
+    const std::size_t first = entityLights.size();
+    const WorldSphere &bounds = worldBounds[node];
+    for (std::uint32_t light : lightGrid.query(bounds.center, bounds.radius)) {
+      // Lights past the capacity of the light block are left out
+      const std::size_t index = first + nodeFrameLight[light];
+      if (index < lightData.size()) {
+        entityLights.push_back(index);
+      }
     }
   }
-  entityShader.setNumberOfLights(found);
-  entity->render(entityShader);
+  entityShader.setLightIndices(entityLights);
 }
 
-void EntityManager::addPointLight(PointLight *source) {
-  lights.push_back(source);
+void EntityManager::setSharedLights() {
+  entityLights.clear();
+  if (dirLight) {
+    entityLights.push_back(0);
+  }
+  entityShader.setLightIndices(entityLights);
 }
 
-void EntityManager::setDirectionalLight(DirectionalLight *source) {
-  dirLight = source;
+InstanceData &EntityManager::addInstance(std::uint32_t node,
+                                         const Vec3d &cameraPos) {
+  InstanceData &instance = modelInstances[nodeModels[node]].emplace_back();
+  instance.setModelMatrix(modelMatrix(node, cameraPos));
+  instance.setNormalMatrix(normalMatrix(node));
+  return instance;
 }
 
-void EntityManager::iterEntities(std::function<void(Entity *)> fn,
-                                 bool includeLights) {
-  for (Entity *entity : solidEntities) {
-    fn(entity);
+void EntityManager::queueEntity(std::uint32_t node, DrawPass pass,
+                                const Vec3d &cameraPos) {
+  const std::uint32_t model = nodeModels[node];
+  const float depth =
+      mat::distance2(sceneGraph.getWorldPosition(node), cameraPos);
+  for (std::uint32_t mesh = modelFirstMesh[model];
+       mesh < modelFirstMesh[model + 1]; mesh++) {
+    renderQueue.push(pass, ENTITY, meshEntries[mesh].globalMaterial, mesh,
+                     depth, node);
   }
-  for (Entity *entity : transparentEntities) {
-    fn(entity);
+}
+
+void EntityManager::queueInstances(DrawPass pass, DrawShader shader) {
+  for (std::uint32_t model = 0; model < models.size(); model++) {
+    std::vector<InstanceData> &instances = modelInstances[model];
+    // Never upload an empty buffer, the vertex arrays can still point to it
+    if (instances.empty())
+      continue;
+    if (usedInstanceBuffers == instanceBuffers.size()) {
+      instanceBuffers.push_back(std::make_unique<InstanceBuffer>());
+    }
+    const std::uint32_t buffer = usedInstanceBuffers++;
+    instanceBuffers[buffer]->upload(instances);
+    instances.clear();
+    // The instances are spread, no depth to sort them by
+    for (std::uint32_t mesh = modelFirstMesh[model];
+         mesh < modelFirstMesh[model + 1]; mesh++) {
+      renderQueue.push(pass, shader, meshEntries[mesh].globalMaterial, mesh,
+                       0.0f, buffer);
+    }
   }
-  if (!includeLights)
-    return;
-  for (Entity *light : lights) {
-    fn(light);
+}
+
+ShaderProgram &EntityManager::useDrawShader(DrawShader shader,
+                                            const Camera &camera) {
+  switch (shader) {
+  case ENTITY:
+    entityShader.use();
+    entityShader.setInstanced(false);
+    return entityShader;
+  case ENTITY_INSTANCES:
+    entityShader.use();
+    // With clustered lights the uniforms are the same for all the entities
+    setSharedLights();
+    entityShader.setInstanced(true);
+    return entityShader;
+  case LIGHT_INSTANCES:
+    lightShader.use();
+    lightShader.setPvMatrix(camera.getProjectionMatrix() *
+                            camera.getViewMatrix());
+    lightShader.setInstanced(true);
+    return lightShader;
+  case GEOMETRY_INSTANCES:
+    break;
   }
-}
\ No newline at end of file
+  GBufferShader &geometryShader = deferredRenderer->getGeometryShader();
+  geometryShader.use();
+  geometryShader.setInstanced(true);
+  return geometryShader;
+}
+
+void EntityManager::drawQueue(const Camera &camera, bool clustered) {
+  const Vec3d &cameraPos = camera.getCameraPos();
+  ShaderProgram *shader = nullptr;
+  // Node whose uniforms are in the entity shader
+  std::uint32_t entity = 0;
+  bool compositing = false;
+  for (const RenderQueue::Draw &draw : renderQueue.sort()) {
+    const MeshEntry &entry = meshEntries[draw.mesh];
+    const Model &model = models[entry.model];
+    const Mesh &mesh = model.getMeshes(entry.material)[entry.index];
+    if (draw.changes & RenderQueue::PASS && draw.pass == TRANSPARENT_PASS &&
+        weightedBlendedOIT) {
+      weightedBlendedOIT->begin();
+      entityShader.use();
+      entityShader.setWeightedBlended(true);
+      compositing = true;
+    }
+    if (draw.changes & RenderQueue::SHADER) {
+      shader = &useDrawShader(static_cast<DrawShader>(draw.shader), camera);
+    }
+    if (draw.changes & RenderQueue::MATERIAL) {
+      model.bindMaterial(*shader, entry.material);
+    }
+    if (draw.changes & RenderQueue::MESH) {
+      mesh.bind();
+    }
+    if (draw.shader != ENTITY) {
+      mesh.drawInstanced(*instanceBuffers[draw.item]);
+      continue;
+    }
+    // Entities sharing a mesh alternate, the uniforms follow the node
+    if (draw.changes & RenderQueue::SHADER || draw.item != entity) {
+      setEntityUniforms(draw.item, cameraPos, clustered);
+      entity = draw.item;
+    }
+    mesh.draw();
+  }
+  if (compositing) {
+    entityShader.use();
+    entityShader.setWeightedBlended(false);
+    weightedBlendedOIT->composite();
+  }
+  const RenderQueue::Stats &stats = renderQueue.getStats();
+  renderStats.draws += stats.draws;
+  renderStats.binds += stats.binds;
+  renderStats.bindsAvoided += stats.bindsAvoided;
+  renderQueue.clear();
+}
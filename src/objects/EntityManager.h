@@ -1,55 +1,266 @@
 #ifndef ENTITY_MANAGER_C
 #define ENTITY_MANAGER_C
 
-#include <functional>
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <ranges>
 
 #include "../Camera.h"
+#include "../buffer/InstanceBuffer.h"
+#include "../ecs/World.h"
+#include "../jobs/JobSystem.h"
+#include "../math/AlignedAllocator.h"
+#include "../math/Frustum.h"
+#include "../math/TransformBatch.h"
 #include "../shaders/Shader.h"
 #include "../shaders/phong_light_model/EntityShader.h"
 #include "../shaders/light_source/LightShader.h"
+#include "Components.h"
+#include "DeferredRenderer.h"
 #include "Light.h"
-#include "Entity.h"
+#include "LightClusters.h"
+#include "LightGrid.h"
 #include "Model.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "TransparentQueue.h"
+#include "WeightedBlendedOIT.h"
 
 class EntityManager {
-  // Distance after which point lights have no effect
-  static constexpr float LIGHT_D2_CUTOFF = 100.0f;
-  // vector of pointers due to possible future inheritance
-  // TODO: instead use references? unique/shared_ptrs?
-
-  // Solid non-transparent entities
-  std::vector<Entity *> solidEntities;
-  // Entities that are transparent or partially transparent,
-  // for example a window
-  std::vector<Entity *> transparentEntities;
-  // Point light sources
-  std::vector<PointLight *> lights;
+public:
+  // How the point lights are matched with what they light
+  enum class LightAssignment {
+    // Lights whose sphere reaches the entity bounds, through the light grid
+    PER_ENTITY,
+    // Lights of the view frustum cluster of each fragment. Falls back to
+    // PER_ENTITY with non perspective projections
+    CLUSTERED
+  };
+
+private:
+  // Cell side of the light grid, about the radius of the default lights
+  static constexpr double LIGHT_CELL_SIZE = 16.0;
+  // Entities integrated by a single job of update
+  static constexpr std::size_t UPDATE_CHUNK = 1024;
+
+  // Fields of the render queue keys, passes are drawn in this order
+  enum DrawPass : std::uint32_t { SOLID_PASS, LIGHT_PASS, TRANSPARENT_PASS };
+  enum DrawShader : std::uint32_t {
+    // Entity shader with the uniforms of a single entity
+    ENTITY,
+    ENTITY_INSTANCES,
+    LIGHT_INSTANCES,
+    GEOMETRY_INSTANCES
+  };
+  // A mesh of a registered model
+  struct MeshEntry {
+    std::uint32_t model;
+    // Material of the model, and across all the models
+    std::uint32_t material;
+    std::uint32_t globalMaterial;
+    // Index in the meshes of the material
+    std::uint32_t index;
+  };
+
+  // Every entity has Transform, Velocity, Renderable and SceneNode
+  // components. Transparent entities add the Transparent tag and point
+  // lights a PointLight, so there are three archetypes.
+  ecs::World world;
+  // Indexed by Renderable::model
+  std::vector<Model> models;
+  // Meshes of all the models, those of model start at modelFirstMesh[model]
+  std::vector<MeshEntry> meshEntries;
+  std::vector<std::uint32_t> modelFirstMesh{0};
+  std::uint32_t materialCount = 0;
+  // Draws of the frame sorted by state, see RenderQueue
+  RenderQueue renderQueue;
+  RenderQueue::Stats renderStats;
+  // Instances of each model queued for the next draw, indexed by model.
+  // Entities whose uniforms only differ by the instance attributes are
+  // drawn with a call per mesh of their model
+  std::vector<std::vector<InstanceData>> modelInstances;
+  // Buffers of the instanced draws of the frame, the first
+  // usedInstanceBuffers are taken
+  std::vector<std::unique_ptr<InstanceBuffer>> instanceBuffers;
+  std::size_t usedInstanceBuffers = 0;
   // Directional light, for the moment at most one because
   // they are expensive to simulate (non local, they act on all entities)
   DirectionalLight *dirLight{nullptr};
   EntityShader &entityShader;
   LightShader &lightShader;
+  JobSystem &jobSystem;
+  // Local matrices of the entities whose transform changed, rebuilt in a
+  // single batched pass
+  TransformBatch transformBatch;
+  AlignedVector<Mat4f, 16> localMatrices;
+  // (node, transform) of the entities in the batch
+  std::vector<std::pair<std::uint32_t, Transform *>> dirtyEntities;
+  // Transform hierarchy of all the entities, it propagates the world
+  // transforms. Nodes are numbered in creation order (SceneNode::node).
+  SceneGraph sceneGraph;
+  // New entities or new parents
+  bool hierarchyDirty = false;
+  // Indexed by node
+  std::vector<ecs::EntityId> nodeEntities;
+  std::vector<std::uint32_t> nodeModels;
+  // Inverse transpose of the world matrices, used to transform the
+  // normals. Rebuilt only when rendered after a change
+  std::vector<Mat3f> normalMatrices;
+  std::vector<std::uint8_t> normalDirty;
+  // World space bounding spheres, updated only for the entities that moved
+  struct WorldSphere {
+    Vec3d center;
+    float radius = 0.0f;
+  };
+  std::vector<WorldSphere> worldBounds;
+  // Same spheres relative to cullingOrigin
+  SphereBatch boundingSpheres;
+  // Visible transparent entities, sorted back to front
+  TransparentQueue transparentQueue;
+  // Blends the transparent entities in any order when set
+  WeightedBlendedOIT *weightedBlendedOIT = nullptr;
+  // Nodes inside the view frustum
+  std::vector<std::uint8_t> visibleNodes;
+  std::size_t culledCount = 0;
+  // Origin of the float bounding spheres. With origin rebasing it follows
+  // the camera, otherwise it's the world origin and far away spheres lose
+  // precision
+  Vec3d cullingOrigin;
+  // Camera distance from cullingOrigin that triggers a rebase, 0 disables it
+  double rebaseDistance = 0.0;
+  // Point lights of the frame being rendered
+  struct FrameLight {
+    const PointLight *light;
+    // Camera relative
+    Vec3f position;
+  };
+  std::vector<FrameLight> frameLights;
+  // Indexed by node: index of the light in frameLights
+  std::vector<std::uint32_t> nodeFrameLight;
+  // Point lights by node, each with the radius of its attenuation.
+  // Lights that didn't move keep their cells
+  LightGrid lightGrid{LIGHT_CELL_SIZE};
+  LightAssignment lightAssignment = LightAssignment::CLUSTERED;
+  LightClusters lightClusters;
+  // Camera relative spheres and shader data of the lights, in the order
+  // of frameLights
+  std::vector<Vec4f> clusterSpheres;
+  std::vector<Vec4f> clusterLightData;
+  // Light block of the entity shader, and the indices in it of the lights
+  // of the entity being drawn
+  std::vector<LightData> lightData;
+  std::vector<int> entityLights;
+  // Shades the solid entities when set, forward shading otherwise
+  DeferredRenderer *deferredRenderer = nullptr;
+  std::vector<DeferredRenderer::PointLightVolume> lightVolumes;
 
 public:
-  EntityManager(EntityShader &entityShader, LightShader &lightShader)
-      : entityShader{entityShader}, lightShader{lightShader} {};
-  void addSolidEntity(Entity *entity) { solidEntities.push_back(entity); };
-  void addTransparentEntity(Entity *entity) {
-    transparentEntities.push_back(entity);
-  };
-  void addPointLight(PointLight *source);
+  EntityManager(EntityShader &entityShader, LightShader &lightShader,
+                JobSystem &jobSystem)
+      : entityShader{entityShader}, lightShader{lightShader},
+        jobSystem{jobSystem} {};
+  // Register a model, returns the id used by the entities that draw it
+  std::uint32_t addModel(Model model);
+  ecs::EntityId addSolidEntity(std::uint32_t model,
+                               Transform transform = Transform());
+  ecs::EntityId addTransparentEntity(std::uint32_t model,
+                                     Transform transform = Transform());
+  // Point light drawn with model
+  ecs::EntityId addPointLight(std::uint32_t model, PointLight light,
+                              Transform transform = Transform());
   void setDirectionalLight(DirectionalLight *source);
+  /**
+   * Attach an entity to a parent, its Transform becomes relative to it.
+   * @param parent - parent entity, ecs::NO_ENTITY to detach the child
+   */
+  void setParent(ecs::EntityId child, ecs::EntityId parent);
+  // Components of the entities, e.g. to move them through their Transform
+  ecs::World &getWorld() { return world; }
 
+  /**
+   * Move the entities and lights by their Velocity. The columns are split
+   * in chunks integrated in parallel by the job system, each entity only
+   * depends on its own components so the result doesn't depend on the
+   * number of threads.
+   */
   void update(float deltaTime);
   void render(const Camera &camera);
+  // Number of entities and lights outside the view frustum
+  // in the last rendered frame
+  std::size_t getCulledCount() const { return culledCount; }
+  // Draws and state binds of the last rendered frame
+  const RenderQueue::Stats &getRenderStats() const { return renderStats; }
+  /**
+   * Enable origin rebasing: when the camera moves farther than distance
+   * from the origin of the culling data, the origin is moved to the camera
+   * and the bounding spheres are recomputed.
+   * @param distance - 0 disables the rebasing
+   */
+  void setOriginRebasing(double distance) { rebaseDistance = distance; }
+  void setLightAssignment(LightAssignment assignment) {
+    lightAssignment = assignment;
+  }
+  /**
+   * Render the solid entities with deferred shading, the renderer owns the
+   * render target. The light models and the transparent entities are still
+   * forward shaded in its lit color.
+   * @param renderer - nullptr to go back to forward shading
+   */
+  void setDeferredRenderer(DeferredRenderer *renderer) {
+    deferredRenderer = renderer;
+  }
+  /**
+   * Draw the transparent entities unsorted with weighted blended
+   * transparency, composited on the render target
+   * @param oit - nullptr to go back to sorting them back to front
+   */
+  void setWeightedBlendedOIT(WeightedBlendedOIT *oit) {
+    weightedBlendedOIT = oit;
+  }
 
 private:
-  void iterEntities(std::function<void(Entity *)> fn, bool includeLights);
-  void renderLights(const Camera &camera);
-  void renderEntities(const Camera &camera);
-  void renderEntity(const Entity *entity);
+  template <typename... Cs>
+  ecs::EntityId createEntity(std::uint32_t model, Transform transform,
+                             Cs &&...components);
+  void rebuildSceneGraph();
+  void updateTransforms();
+  void updateBoundingSphere(std::uint32_t node);
+  void rebaseOrigin(const Vec3d &cameraPos);
+  void cullEntities(const Camera &camera);
+  // World matrix of a node with the translation relative to origin
+  Mat4f modelMatrix(std::uint32_t node, const Vec3d &origin) const;
+  const Mat3f &normalMatrix(std::uint32_t node);
+  bool useClusters(const Camera &camera) const;
+  // Collect the point lights of the frame in frameLights
+  void gatherLights(const Camera &camera);
+  void queueLights(const Camera &camera);
+  void clusterLights(const Camera &camera);
+  // Set up the entity shader for the camera, returns whether it's clustered
+  bool useEntityShader(const Camera &camera);
+  template <typename F> void eachVisibleSolid(F &&function);
+  void queueSolidEntities(const Camera &camera, bool clustered);
+  void queueTransparentEntities(const Camera &camera, bool clustered);
+  // Draw the transparent entities back to front, without OIT
+  void renderSortedTransparent(const Camera &camera, bool clustered);
+  void renderForward(const Camera &camera, bool solids);
+  void renderDeferred(const Camera &camera);
+  // Set the model, normal and light uniforms of the entity shader for node
+  void setEntityUniforms(std::uint32_t node, const Vec3d &cameraPos,
+                         bool clustered);
+  // Light the next entities with the directional light only, for the
+  // instances with clustered point lights
+  void setSharedLights();
+  // Queue an instance of the model of node, with its matrices
+  InstanceData &addInstance(std::uint32_t node, const Vec3d &cameraPos);
+  // Queue a draw of each mesh of the model of node, drawn alone
+  void queueEntity(std::uint32_t node, DrawPass pass, const Vec3d &cameraPos);
+  // Upload the queued instances of all the models and queue their draws
+  void queueInstances(DrawPass pass, DrawShader shader);
+  // Use the shader of a draw, returns the program that binds the materials
+  ShaderProgram &useDrawShader(DrawShader shader, const Camera &camera);
+  // Draw and clear the render queue, binding only the state that changes
+  void drawQueue(const Camera &camera, bool clustered);
 };
 
-#endif // ENTITY_MANAGER_C
\ No newline at end of file
+#endif // ENTITY_MANAGER_C
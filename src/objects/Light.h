@@ -1,8 +1,11 @@
 #ifndef LIGHT_C
 #define LIGHT_C
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "../math/Matrix.h"
-#include "Entity.h"
 
 class Light {
 public:
@@ -10,27 +13,50 @@ public:
   Vec3f ambientIntensity;
   Vec3f diffuseIntensity;
   Vec3f specularIntensity;
-  Light(Light &&light) = default;
   Light(Vec3f lightColor) : lightColor{std::move(lightColor)} {
     // Default values that seems to give good results
     ambientIntensity = this->lightColor * 0.1f;
     diffuseIntensity = this->lightColor * 0.25f;
     specularIntensity = this->lightColor.clone();
   }
-  virtual Vec4f getLightVector() const = 0;
-  virtual ~Light() = default;
 };
 
-class PointLight : public Entity, public Light {
+// Component of the point light entities, their position is the one of the
+// entity Transform
+class PointLight : public Light {
 public:
+  // Attenuated intensity below which the light has no visible effect,
+  // less than a step of an 8 bit color channel
+  static constexpr float MIN_INTENSITY = 1.0f / 256.0f;
+
   // By default set a realistic 1/d^2 attenuation
   Vec3f attenuationCoefficients = Vec3f{0.0f, 0.0f, 1.0f};
-  PointLight(PointLight &&light) = default;
-  PointLight(Model model, Vec3f lightColor)
-      : Entity{std::move(model)}, Light{std::move(lightColor)} {};
-  Vec4f getLightVector() const override {
-    const Vec3f &pos = this->position;
-    return Vec4f{pos(0), pos(1), pos(2), 1.0f};
+  PointLight(Vec3f lightColor) : Light{std::move(lightColor)} {};
+
+  /**
+   * Distance after which the light has no visible effect: the strongest
+   * channel, attenuated by 1 / (c0 + c1 * d + c2 * d^2), drops below
+   * MIN_INTENSITY. Infinity if the light is not attenuated
+   */
+  float getRadius() const {
+    float intensity = 0.0f;
+    for (int i = 0; i < 3; i++) {
+      intensity = std::max(intensity, ambientIntensity(i) +
+                                          diffuseIntensity(i) +
+                                          specularIntensity(i));
+    }
+    const float c0 = attenuationCoefficients(0);
+    const float c1 = attenuationCoefficients(1);
+    const float c2 = attenuationCoefficients(2);
+    // Solve c0 + c1 * d + c2 * d^2 = intensity / MIN_INTENSITY
+    const float k = intensity / MIN_INTENSITY - c0;
+    if (k <= 0.0f)
+      return 0.0f;
+    if (c2 > 0.0f)
+      return (std::sqrt(c1 * c1 + 4.0f * c2 * k) - c1) / (2.0f * c2);
+    if (c1 > 0.0f)
+      return k / c1;
+    return std::numeric_limits<float>::infinity();
   }
 };
 
@@ -39,9 +65,10 @@ public:
   Vec3f direction;
   DirectionalLight(Vec3f direction, Vec3f lightColor)
       : Light{std::move(lightColor)}, direction{std::move(direction)} {}
-  Vec4f getLightVector() const override {
+  // Fourth component 0.0, like the directions in the shader
+  Vec4f getLightVector() const {
     return Vec4f{direction(0), direction(1), direction(2), 0.0f};
   }
 };
 
-#endif // LIGHT_C
\ No newline at end of file
+#endif // LIGHT_C
@@ -0,0 +1,149 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void LightClusters::setProjection(const Mat4f &newProjection) {
+  if (!isPerspective(newProjection)) {
+    throw std::runtime_error("Light clusters need a perspective projection");
+  }
+  if (newProjection == projection)
+    return;
+  projection = newProjection.clone();
+  near = projection(2, 3) / (projection(2, 2) - 1.0f);
+  far = projection(2, 3) / (projection(2, 2) + 1.0f);
+  sliceScale = SLICES / std::log(far / near);
+
+  bounds.resize(CLUSTER_COUNT);
+  for (std::uint32_t k = 0; k < SLICES; k++) {
+    const float depths[2] = {sliceDepth(k), sliceDepth(k + 1)};
+    for (std::uint32_t y = 0; y < TILES_Y; y++) {
+      for (std::uint32_t x = 0; x < TILES_X; x++) {
+        std::array<float, 6> &box = bounds[x + TILES_X * (y + TILES_Y * k)];
+        const std::uint32_t tile[2] = {x, y};
+        const std::uint32_t tiles[2] = {TILES_X, TILES_Y};
+        // The tile edges are lines through the eye, the box has to contain
+        // their points at both the slice depths
+        for (int a = 0; a < 2; a++) {
+          const float ndc0 = -1.0f + 2.0f * tile[a] / tiles[a];
+          const float ndc1 = -1.0f + 2.0f * (tile[a] + 1) / tiles[a];
+          box[a] = std::min(fromNdc(a, ndc0, depths[0]),
+                            fromNdc(a, ndc0, depths[1]));
+          box[a + 3] = std::max(fromNdc(a, ndc1, depths[0]),
+                                fromNdc(a, ndc1, depths[1]));
+        }
+        // The camera looks down -z
+        box[2] = -depths[1];
+        box[5] = -depths[0];
+      }
+    }
+  }
+}
+
+float LightClusters::sliceDepth(std::uint32_t slice) const {
+  if (slice >= SLICES)
+    return far;
+  return near * std::pow(far / near, static_cast<float>(slice) / SLICES);
+}
+
+std::uint32_t LightClusters::sliceOf(float depth) const {
+  float slice =
+      std::floor(std::log(std::max(depth, near) / near) * sliceScale);
+  return std::clamp(slice, 0.0f, SLICES - 1.0f);
+}
+
+std::uint32_t LightClusters::tileOf(int axis, float ndc) {
+  const float tiles = axis == 0 ? TILES_X : TILES_Y;
+  // Clamped as float, ndc can be infinite
+  return std::clamp(std::floor((ndc + 1.0f) * 0.5f * tiles), 0.0f,
+                    tiles - 1.0f);
+}
+
+// ndc = (P(a, a) * v + P(a, 2) * z) / -z with z = -depth
+float LightClusters::toNdc(int axis, float value, float depth) const {
+  return projection(axis, axis) * value / depth - projection(axis, 2);
+}
+
+float LightClusters::fromNdc(int axis, float ndc, float depth) const {
+  return (ndc + projection(axis, 2)) * depth / projection(axis, axis);
+}
+
+std::uint32_t LightClusters::clusterOf(const Vec3f &viewPosition) const {
+  const float depth = -viewPosition(2);
+  const std::uint32_t x = tileOf(0, toNdc(0, viewPosition(0), depth));
+  const std::uint32_t y = tileOf(1, toNdc(1, viewPosition(1), depth));
+  return x + TILES_X * (y + TILES_Y * sliceOf(depth));
+}
+
+void LightClusters::build(const Mat4f &view, std::span<const Vec4f> lights) {
+  if (bounds.empty()) {
+    throw std::runtime_error("Light clusters without a projection");
+  }
+  hits.clear();
+  for (std::uint32_t l = 0; l < lights.size(); l++) {
+    const Vec4f &light = lights[l];
+    Vec3f center;
+    for (int i = 0; i < 3; i++) {
+      center(i) = view(i, 0) * light(0) + view(i, 1) * light(1) +
+                  view(i, 2) * light(2) + view(i, 3);
+    }
+    const float radius = light(3);
+    const float depth = -center(2);
+    // Negated to skip NaNs too
+    if (!(depth + radius > near) || !(depth - radius < far))
+      continue;
+    const float depthMin = std::max(depth - radius, near);
+    const float depthMax = std::min(depth + radius, far);
+
+    // Range of clusters overlapped by the box of the sphere. The ndc of a
+    // point is monotonic in its depth, the extremes are at depthMin or
+    // depthMax
+    std::uint32_t first[3], last[3];
+    for (int a = 0; a < 2; a++) {
+      first[a] = tileOf(a, std::min(toNdc(a, center(a) - radius, depthMin),
+                                    toNdc(a, center(a) - radius, depthMax)));
+      last[a] = tileOf(a, std::max(toNdc(a, center(a) + radius, depthMin),
+                                   toNdc(a, center(a) + radius, depthMax)));
+    }
+    first[2] = sliceOf(depthMin);
+    last[2] = sliceOf(depthMax);
+
+    for (std::uint32_t k = first[2]; k <= last[2]; k++) {
+      for (std::uint32_t y = first[1]; y <= last[1]; y++) {
+        for (std::uint32_t x = first[0]; x <= last[0]; x++) {
+          const std::uint32_t cluster = x + TILES_X * (y + TILES_Y * k);
+          const std::array<float, 6> &box = bounds[cluster];
+          float d2 = 0.0f;
+          for (int i = 0; i < 3; i++) {
+            float d = center(i) - std::clamp(center(i), box[i], box[i + 3]);
+            d2 += d * d;
+          }
+          if (d2 <= radius * radius) {
+            hits.push_back({cluster, l});
+          }
+        }
+      }
+    }
+  }
+
+  // Counting sort of the hits by cluster, the lights of a cluster stay in
+  // ascending order
+  clusterRanges.assign(2 * CLUSTER_COUNT, 0);
+  for (const auto &[cluster, light] : hits) {
+    clusterRanges[2 * cluster + 1]++;
+  }
+  std::uint32_t offset = 0;
+  for (std::uint32_t c = 0; c < CLUSTER_COUNT; c++) {
+    clusterRanges[2 * c] = offset;
+    offset += clusterRanges[2 * c + 1];
+  }
+  lightIndices.resize(hits.size());
+  cursors.resize(CLUSTER_COUNT);
+  for (std::uint32_t c = 0; c < CLUSTER_COUNT; c++) {
+    cursors[c] = clusterRanges[2 * c];
+  }
+  for (const auto &[cluster, light] : hits) {
+    lightIndices[cursors[cluster]++] = light;
+  }
+}
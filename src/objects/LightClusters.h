@@ -0,0 +1,77 @@
+#ifndef LIGHT_CLUSTERS_C
+#define LIGHT_CLUSTERS_C
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../math/Matrix.h"
+
+/**
+ * Point lights binned in the clusters of a view frustum (froxels), for
+ * clustered forward shading: each fragment only shades the lights of its
+ * cluster.
+ * The frustum is split in TILES_X x TILES_Y screen tiles and SLICES depth
+ * slices, exponentially spaced between the near and far planes so that
+ * clusters are roughly cubic. The slice of view depth d is
+ * floor(log(d / near) * sliceScale), the shader must compute the clusters
+ * the same way.
+ */
+class LightClusters {
+public:
+  static constexpr std::uint32_t TILES_X = 16;
+  static constexpr std::uint32_t TILES_Y = 9;
+  static constexpr std::uint32_t SLICES = 24;
+  static constexpr std::uint32_t CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+  static bool isPerspective(const Mat4f &projection) {
+    return projection(3, 2) == -1.0f && projection(3, 3) == 0.0f;
+  }
+  /**
+   * Recompute the clusters bounds if the projection changed.
+   * Throws if it's not a perspective projection
+   */
+  void setProjection(const Mat4f &projection);
+  /**
+   * Bin the lights in the clusters, by index
+   * @param view - rotation only view matrix, see Camera
+   * @param lights - camera relative center and radius of each light
+   */
+  void build(const Mat4f &view, std::span<const Vec4f> lights);
+  // (offset, count) of the lights of each cluster in getLightIndices
+  std::span<const std::uint32_t> getClusterRanges() const {
+    return clusterRanges;
+  }
+  std::span<const std::uint32_t> getLightIndices() const {
+    return lightIndices;
+  }
+  float getNear() const { return near; }
+  float getSliceScale() const { return sliceScale; }
+  // Cluster of a point in view space, inside the frustum
+  std::uint32_t clusterOf(const Vec3f &viewPosition) const;
+
+private:
+  Mat4f projection;
+  float near = 0.0f;
+  float far = 0.0f;
+  float sliceScale = 0.0f;
+  // View space axis aligned boxes of the clusters: min x, y, z, max x, y, z
+  std::vector<std::array<float, 6>> bounds;
+  std::vector<std::uint32_t> clusterRanges;
+  std::vector<std::uint32_t> lightIndices;
+  // (cluster, light) pairs found by build, in light order
+  std::vector<std::array<std::uint32_t, 2>> hits;
+  // Next free index of each cluster in lightIndices
+  std::vector<std::uint32_t> cursors;
+
+  float sliceDepth(std::uint32_t slice) const;
+  std::uint32_t sliceOf(float depth) const;
+  // Tile column (axis 0) or row (axis 1) of ndc coordinate, clamped
+  static std::uint32_t tileOf(int axis, float ndc);
+  // Normalized device coordinate of a view space coordinate at depth
+  float toNdc(int axis, float value, float depth) const;
+  float fromNdc(int axis, float ndc, float depth) const;
+};
+
+#endif // LIGHT_CLUSTERS_C
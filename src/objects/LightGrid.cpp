@@ -0,0 +1,171 @@
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "../math/MatrixUtils.h"
+
+LightGrid::LightGrid(double cellSize) : cellSize{cellSize} {
+  if (!(cellSize > 0.0)) {
+    throw std::runtime_error("Light grid cells must have a positive size");
+  }
+}
+
+bool LightGrid::cellRange(const Vec3d &center, float radius,
+                          CellRange &range) const {
+  if (!std::isfinite(radius))
+    return false;
+  // Counted in double first, huge radii would overflow the integers
+  double count = 1.0;
+  std::array<double, 3> min, max;
+  for (int i = 0; i < 3; i++) {
+    min[i] = std::floor((center(i) - radius) / cellSize);
+    max[i] = std::floor((center(i) + radius) / cellSize);
+    count *= max[i] - min[i] + 1.0;
+  }
+  if (count > MAX_CELLS_PER_LIGHT)
+    return false;
+  for (int i = 0; i < 3; i++) {
+    range.min[i] = static_cast<std::int64_t>(min[i]);
+    range.max[i] = static_cast<std::int64_t>(max[i]);
+  }
+  return true;
+}
+
+// 21 bits per coordinate. Far cells can share a key, the exact sphere test
+// of query discards the lights they add
+std::uint64_t LightGrid::cellKey(std::int64_t x, std::int64_t y,
+                                 std::int64_t z) {
+  constexpr std::uint64_t MASK = (1u << 21) - 1;
+  return (static_cast<std::uint64_t>(x) & MASK) << 42 |
+         (static_cast<std::uint64_t>(y) & MASK) << 21 |
+         (static_cast<std::uint64_t>(z) & MASK);
+}
+
+void LightGrid::insertCells(std::uint32_t light, const CellRange &range) {
+  for (std::int64_t x = range.min[0]; x <= range.max[0]; x++) {
+    for (std::int64_t y = range.min[1]; y <= range.max[1]; y++) {
+      for (std::int64_t z = range.min[2]; z <= range.max[2]; z++) {
+        cells[cellKey(x, y, z)].push_back(light);
+      }
+    }
+  }
+}
+
+void LightGrid::eraseCells(std::uint32_t light, const CellRange &range) {
+  for (std::int64_t x = range.min[0]; x <= range.max[0]; x++) {
+    for (std::int64_t y = range.min[1]; y <= range.max[1]; y++) {
+      for (std::int64_t z = range.min[2]; z <= range.max[2]; z++) {
+        auto it = cells.find(cellKey(x, y, z));
+        std::vector<std::uint32_t> &ids = it->second;
+        *std::find(ids.begin(), ids.end(), light) = ids.back();
+        ids.pop_back();
+        if (ids.empty()) {
+          cells.erase(it);
+        }
+      }
+    }
+  }
+}
+
+void LightGrid::unlink(std::uint32_t light) {
+  LightEntry &entry = lights[light];
+  if (entry.global == NO_LIGHT) {
+    eraseCells(light, entry.cells);
+    return;
+  }
+  // Swap remove
+  globalLights[entry.global] = globalLights.back();
+  lights[globalLights.back()].global = entry.global;
+  globalLights.pop_back();
+  entry.global = NO_LIGHT;
+}
+
+void LightGrid::set(std::uint32_t light, const Vec3d &center, float radius) {
+  if (light == NO_LIGHT) {
+    throw std::runtime_error("Invalid light id");
+  }
+  if (light >= lights.size()) {
+    lights.resize(light + 1);
+    lastQuery.resize(light + 1, 0);
+  }
+  CellRange range;
+  const bool inCells = cellRange(center, radius, range);
+  LightEntry &entry = lights[light];
+  entry.center = center.clone();
+  entry.radius = radius;
+  if (entry.present) {
+    // Still in the same cells
+    if (inCells ? entry.global == NO_LIGHT && entry.cells == range
+                : entry.global != NO_LIGHT)
+      return;
+    unlink(light);
+  } else {
+    entry.present = true;
+    lightCount++;
+  }
+  if (inCells) {
+    entry.cells = range;
+    insertCells(light, range);
+  } else {
+    entry.global = globalLights.size();
+    globalLights.push_back(light);
+  }
+}
+
+void LightGrid::remove(std::uint32_t light) {
+  if (!contains(light))
+    return;
+  unlink(light);
+  lights[light].present = false;
+  lightCount--;
+}
+
+void LightGrid::test(std::uint32_t light, const Vec3d &center,
+                     float radius) {
+  if (lastQuery[light] == queryCount)
+    return;
+  lastQuery[light] = queryCount;
+  const LightEntry &entry = lights[light];
+  const double r = static_cast<double>(radius) + entry.radius;
+  if (mat::distance2(center, entry.center) < r * r) {
+    found.push_back(light);
+  }
+}
+
+std::span<const std::uint32_t> LightGrid::query(const Vec3d &center,
+                                                float radius) {
+  if (++queryCount == 0) {
+    std::fill(lastQuery.begin(), lastQuery.end(), 0);
+    queryCount = 1;
+  }
+  found.clear();
+  for (std::uint32_t light : globalLights) {
+    test(light, center, radius);
+  }
+  CellRange range;
+  if (cellRange(center, radius, range)) {
+    for (std::int64_t x = range.min[0]; x <= range.max[0]; x++) {
+      for (std::int64_t y = range.min[1]; y <= range.max[1]; y++) {
+        for (std::int64_t z = range.min[2]; z <= range.max[2]; z++) {
+          auto it = cells.find(cellKey(x, y, z));
+          if (it == cells.end())
+            continue;
+          for (std::uint32_t light : it->second) {
+            test(light, center, radius);
+          }
+        }
+      }
+    }
+  } else {
+    // The query covers too many cells, faster to test all the lights
+    for (std::uint32_t light = 0; light < lights.size(); light++) {
+      if (lights[light].present) {
+        test(light, center, radius);
+      }
+    }
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
@@ -0,0 +1,92 @@
+#ifndef LIGHT_GRID_C
+#define LIGHT_GRID_C
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "../math/Matrix.h"
+
+/**
+ * Uniform spatial hash of light spheres, used to find the lights that
+ * reach an entity without testing all of them.
+ * Each light is stored in every cell overlapped by its bounding box, a
+ * query visits the cells overlapped by the query sphere and keeps the
+ * lights whose sphere intersects it. Moving a light only touches the cells
+ * it left and entered, a light that moves inside its cells is updated in
+ * constant time.
+ * Lights too large for the grid are kept in a list tested by every query.
+ * Lights are identified by ids chosen by the caller, ids should be dense
+ * because the grid keeps an array indexed by them.
+ */
+class LightGrid {
+public:
+  static constexpr std::uint32_t NO_LIGHT =
+      std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * @param cellSize - side of the cells, about the typical light radius
+   */
+  explicit LightGrid(double cellSize);
+  /**
+   * Insert a light, or move it if it's already in the grid
+   * @param radius - influence radius, it can be infinite
+   */
+  void set(std::uint32_t light, const Vec3d &center, float radius);
+  void remove(std::uint32_t light);
+  bool contains(std::uint32_t light) const {
+    return light < lights.size() && lights[light].present;
+  }
+  std::size_t size() const { return lightCount; }
+  /**
+   * Ids, in ascending order, of the lights whose sphere intersects the
+   * given sphere. The span is valid until the next call.
+   */
+  std::span<const std::uint32_t> query(const Vec3d &center, float radius);
+
+private:
+  // Lights covering more cells than this are tested by every query
+  static constexpr std::int64_t MAX_CELLS_PER_LIGHT = 512;
+
+  // Inclusive range of cell coordinates
+  struct CellRange {
+    std::array<std::int64_t, 3> min, max;
+    bool operator==(const CellRange &) const = default;
+  };
+  struct LightEntry {
+    Vec3d center;
+    float radius;
+    CellRange cells;
+    bool present = false;
+    // Index in globalLights, NO_LIGHT if the light is stored in the cells
+    std::uint32_t global = NO_LIGHT;
+  };
+
+  double cellSize;
+  std::size_t lightCount = 0;
+  // Indexed by light id
+  std::vector<LightEntry> lights;
+  // Light ids in each cell, keyed by the packed cell coordinates
+  std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+  std::vector<std::uint32_t> globalLights;
+  // Last query that tested each light, to report it once
+  std::vector<std::uint32_t> lastQuery;
+  std::uint32_t queryCount = 0;
+  // Output of query
+  std::vector<std::uint32_t> found;
+
+  // False if the range would have more than MAX_CELLS_PER_LIGHT cells
+  bool cellRange(const Vec3d &center, float radius, CellRange &range) const;
+  static std::uint64_t cellKey(std::int64_t x, std::int64_t y,
+                               std::int64_t z);
+  void insertCells(std::uint32_t light, const CellRange &range);
+  void eraseCells(std::uint32_t light, const CellRange &range);
+  // Remove a light from the cells or from the global lights
+  void unlink(std::uint32_t light);
+  void test(std::uint32_t light, const Vec3d &center, float radius);
+};
+
+#endif // LIGHT_GRID_C
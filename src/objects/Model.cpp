@@ -1,7 +1,10 @@
 #include "Model.h"
 
 #include <assimp/Importer.hpp>
+#include <algorithm>
 #include <assimp/postprocess.h>
+#include <cmath>
+#include <limits>
 #include <ranges>
 
 static TextureType assimpConverter(aiTextureType type) {
@@ -48,36 +51,65 @@ void Mesh::setupMesh(std::span<Vertex> vertices,
                         (void *)(offsetof(Vertex, texCoords)));
 
   // Unbind
-  glBindVertexArray(0);
+  GLState::get().bindVertexArray(0);
+}
+
+Mesh Mesh::screenQuad() {
+  std::vector<Vertex> vertices{{{-1.0f, -1.0f, 0.0f}, {}, {0.0f, 0.0f}},
+                              {{1.0f, -1.0f, 0.0f}, {}, {1.0f, 0.0f}},
+                              {{1.0f, 1.0f, 0.0f}, {}, {1.0f, 1.0f}},
+                              {{-1.0f, 1.0f, 0.0f}, {}, {0.0f, 1.0f}}};
+  std::vector<unsigned int> indices{0, 1, 2, 0, 2, 3};
+  return Mesh{vertices, indices};
 }
 
 void Mesh::render() const {
-  rawMesh->vao.bind();
+  bind();
+  draw();
+}
+
+void Mesh::bind() const { rawMesh->vao.bind(); }
+
+void Mesh::draw() const {
   glDrawElements(GL_TRIANGLES, this->nVertices, GL_UNSIGNED_INT, 0);
 }
 
+void Mesh::drawInstanced(const InstanceBuffer &instances) const {
+  if (rawMesh->instanceBuffer != instances.getID()) {
+    instances.setupAttributes();
+    rawMesh->instanceBuffer = instances.getID();
+  }
+  glDrawElementsInstanced(GL_TRIANGLES, this->nVertices, GL_UNSIGNED_INT, 0,
+                          instances.size());
+}
+
 Model::Model(std::string_view path) { loadModel(path); }
 
-void Model::render(ShaderProgram &shader) const {
-  for (const auto &[mesh_block, textures] : meshes) {
-    unsigned int diffuseNr = 0;
-    unsigned int specularNr = 0;
-    for (const auto &[i, texture] : std::views::enumerate(textures)) {
-      int number;
-      glActiveTexture(GL_TEXTURE0 + i);
-      texture->bind();
-      if (texture->getType() == TextureType::DIFFUSE) {
-        number = ++diffuseNr;
-      } else if (texture->getType() == TextureType::SPECULAR) {
-        number = ++specularNr;
-      } else {
-        throw std::runtime_error("Texture not supported yet");
-      }
-      // Ignore the return type since some shaders
-      // simply might not be using all the textures of the model.
-      shader.setTexture(texture->getType(), number, i);
+void Model::bindMaterial(ShaderProgram &shader, std::size_t material) const {
+  const MeshTextures &textures = meshes[material].second;
+  unsigned int diffuseNr = 0;
+  unsigned int specularNr = 0;
+  for (const auto &[i, texture] : std::views::enumerate(textures)) {
+    int number;
+    GLState::get().activeTexture(i);
+    texture->bind();
+    if (texture->getType() == TextureType::DIFFUSE) {
+      number = ++diffuseNr;
+    } else if (texture->getType() == TextureType::SPECULAR) {
+      number = ++specularNr;
+    } else {
+      throw std::runtime_error("Texture not supported yet");
     }
-    for (const auto &mesh : mesh_block) {
+    // Ignore the return type since some shaders
+    // simply might not be using all the textures of the model.
+    shader.setTexture(texture->getType(), number, i);
+  }
+}
+
+void Model::render(ShaderProgram &shader) const {
+  for (std::size_t material = 0; material < meshes.size(); material++) {
+    bindMaterial(shader, material);
+    for (const auto &mesh : meshes[material].first) {
       mesh.render();
     }
   }
@@ -85,15 +117,22 @@ void Model::render(ShaderProgram &shader) const {
 
 void Model::loadModel(std::string_view path) {
   Assimp::Importer importer;
+  // Flat normals are generated for the meshes that don't have them
   const aiScene *scene =
-      importer.ReadFile(path.data(), aiProcess_Triangulate | aiProcess_FlipUVs);
+      importer.ReadFile(path.data(), aiProcess_Triangulate | aiProcess_FlipUVs |
+                                         aiProcess_GenNormals);
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
     throw std::runtime_error(
         std::format("Assimp error {}", importer.GetErrorString()));
   }
   directory = path.substr(0, path.find_last_of('/'));
+  for (int i = 0; i < 3; i++) {
+    bounds.min[i] = std::numeric_limits<float>::max();
+    bounds.max[i] = std::numeric_limits<float>::lowest();
+  }
   processNode(scene->mRootNode, scene);
+  computeBoundingSphere();
   loadedTextures.clear();
   directory.clear();
 }
@@ -119,6 +158,10 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
     vertex.position[0] = mesh->mVertices[i].x;
     vertex.position[1] = mesh->mVertices[i].y;
     vertex.position[2] = mesh->mVertices[i].z;
+    for (int j = 0; j < 3; j++) {
+      bounds.min[j] = std::min(bounds.min[j], vertex.position[j]);
+      bounds.max[j] = std::max(bounds.max[j], vertex.position[j]);
+    }
 
     if (mesh->mNormals) {
       vertex.normal[0] = mesh->mNormals[i].x;
@@ -180,6 +223,21 @@ Model::MeshTextures Model::loadMaterialTextures(aiMaterial *mat,
   return res;
 }
 
+void Model::computeBoundingSphere() {
+  // Empty model
+  if (bounds.min[0] > bounds.max[0]) {
+    bounds = Bounds{};
+    return;
+  }
+  float r2 = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    bounds.center[i] = (bounds.min[i] + bounds.max[i]) * 0.5f;
+    float halfSide = (bounds.max[i] - bounds.min[i]) * 0.5f;
+    r2 += halfSide * halfSide;
+  }
+  bounds.radius = std::sqrt(r2);
+}
+
 void Model::addMesh(Mesh mesh, MeshTextures meshTextures) {
   // Check if the same vector of textures has already been loaded
   for (auto &[mesh_block, textures] : meshes) {
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "../buffer/Buffer.h"
+#include "../buffer/InstanceBuffer.h"
 #include "../math/Matrix.h"
 #include "../shaders/Shader.h"
 #include "../textures/Texture.h"
@@ -20,6 +21,8 @@ public:
   Buffer<BUFFER_TYPE::VAO> vao;
   Buffer<BUFFER_TYPE::VBO> vbo;
   Buffer<BUFFER_TYPE::EBO> ebo;
+  // Instance buffer the instance attributes of vao point to, 0 if none
+  GLuint instanceBuffer = 0;
 };
 
 struct Vertex {
@@ -29,13 +32,33 @@ struct Vertex {
   float texCoords[2];
 };
 
+// Model space bounding volumes, C style arrays like Vertex
+// to keep Model cheap to copy
+struct Bounds {
+  // Axis aligned bounding box
+  float min[3];
+  float max[3];
+  // Sphere containing the box
+  float center[3];
+  float radius;
+};
+
 class Mesh {
 public:
   Mesh(std::span<Vertex> vertices, std::span<unsigned int> indices);
   // Thanks to shared_ptr copy is cheap.
   Mesh(const Mesh &mesh) = default;
   Mesh(Mesh &&mesh) = default;
+  // Two triangles covering the screen in normalized device coordinates
+  static Mesh screenQuad();
   void render() const;
+  // Bind the vertex array, for draw and drawInstanced
+  void bind() const;
+  // Draw with the vertex array already bound
+  void draw() const;
+  // Draw an instance for each element of instances in a single call, with
+  // the vertex array already bound
+  void drawInstanced(const InstanceBuffer &instances) const;
 
 private:
   std::shared_ptr<RawMesh> rawMesh;
@@ -54,10 +77,19 @@ public:
   Model(Model &&model) = default;
 
   void render(ShaderProgram &program) const;
+  // Meshes are grouped by material, the textures they share
+  std::size_t getMaterialCount() const { return meshes.size(); }
+  std::span<const Mesh> getMeshes(std::size_t material) const {
+    return meshes[material].first;
+  }
+  // Bind the textures of a material and set the samplers of program
+  void bindMaterial(ShaderProgram &program, std::size_t material) const;
+  const Bounds &getBounds() const { return bounds; }
 
 private:
   using MeshTextures = std::vector<std::shared_ptr<Texture>>;
   std::vector<std::pair<std::vector<Mesh>, MeshTextures>> meshes;
+  Bounds bounds;
   // The following variables are cleared once the Model is loaded.
   // map path -> texture,
   std::unordered_map<std::string, std::shared_ptr<Texture>> loadedTextures;
@@ -69,6 +101,7 @@ private:
   MeshTextures processMeshTexture(aiMesh *mesh, const aiScene *scene);
   MeshTextures loadMaterialTextures(aiMaterial *mat, aiTextureType type);
   void addMesh(Mesh mesh, MeshTextures meshTextures);
+  void computeBoundingSphere();
 };
 
 #endif // MODEL_C
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+// Lowest bits of a field
+static std::uint64_t field(std::uint32_t value, int bits) {
+  return value & ((std::uint64_t{1} << bits) - 1);
+}
+
+void RenderQueue::push(std::uint32_t pass, std::uint32_t shader,
+                       std::uint32_t material, std::uint32_t mesh,
+                       float depth, std::uint32_t item) {
+  std::uint64_t key = field(pass, PASS_BITS);
+  key = key << SHADER_BITS | field(shader, SHADER_BITS);
+  key = key << MATERIAL_BITS | field(material, MATERIAL_BITS);
+  key = key << MESH_BITS | field(mesh, MESH_BITS);
+  // The bits of non negative floats are ordered like their values
+  key = key << DEPTH_BITS | std::bit_cast<std::uint32_t>(depth);
+  draws.push_back(Draw{key, pass, shader, material, mesh, item, 0});
+}
+
+void RenderQueue::radixSort() {
+  scratch.resize(entries.size());
+  for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+    std::array<std::size_t, BUCKETS> offsets{};
+    for (const Entry &entry : entries) {
+      offsets[(entry.key >> shift) & (BUCKETS - 1)]++;
+    }
+    // All the keys share this digit, like the pass of a single pass queue
+    if (std::ranges::find(offsets, entries.size()) != offsets.end())
+      continue;
+    std::size_t offset = 0;
+    for (std::size_t &bucket : offsets) {
+      const std::size_t count = bucket;
+      bucket = offset;
+      offset += count;
+    }
+    for (const Entry &entry : entries) {
+      scratch[offsets[(entry.key >> shift) & (BUCKETS - 1)]++] = entry;
+    }
+    entries.swap(scratch);
+  }
+}
+
+std::span<const RenderQueue::Draw> RenderQueue::sort() {
+  entries.clear();
+  for (std::uint32_t i = 0; i < draws.size(); i++) {
+    entries.push_back(Entry{draws[i].key, i});
+  }
+  radixSort();
+
+  stats = Stats{};
+  sorted.clear();
+  for (const Entry &entry : entries) {
+    Draw draw = draws[entry.draw];
+    const Draw *previous = sorted.empty() ? nullptr : &sorted.back();
+    if (!previous || draw.pass != previous->pass) {
+      draw.changes = PASS | SHADER | MATERIAL | MESH;
+    } else if (draw.shader != previous->shader) {
+      draw.changes = SHADER | MATERIAL;
+    } else if (draw.material != previous->material) {
+      draw.changes = MATERIAL;
+    }
+    if (previous && draw.mesh != previous->mesh) {
+      draw.changes |= MESH;
+    }
+    const int binds = std::popcount(draw.changes & (SHADER | MATERIAL | MESH));
+    stats.binds += binds;
+    stats.bindsAvoided += 3 - binds;
+    sorted.push_back(draw);
+  }
+  stats.draws = sorted.size();
+  return sorted;
+}
@@ -0,0 +1,86 @@
+#ifndef RENDER_QUEUE_C
+#define RENDER_QUEUE_C
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Draws of a frame, sorted so that the draws sharing GL state are
+ * consecutive. Each draw has a 64 bit key, from the most significant bits:
+ * pass, shader, material (texture set), mesh and depth, front to back to
+ * help the early depth test. Fields too large for their bits are
+ * truncated, which only costs some sharing.
+ * After sorting every draw tells which state changed since the previous
+ * one, the executor binds only that.
+ */
+class RenderQueue {
+public:
+  static constexpr int PASS_BITS = 2;
+  static constexpr int SHADER_BITS = 4;
+  static constexpr int MATERIAL_BITS = 12;
+  static constexpr int MESH_BITS = 14;
+  static constexpr int DEPTH_BITS = 32;
+  static_assert(PASS_BITS + SHADER_BITS + MATERIAL_BITS + MESH_BITS +
+                    DEPTH_BITS ==
+                64);
+
+  // Flags of Draw::changes. A pass change changes everything, a shader
+  // change the material too: its samplers have to be set
+  static constexpr std::uint32_t PASS = 1;
+  static constexpr std::uint32_t SHADER = 2;
+  static constexpr std::uint32_t MATERIAL = 4;
+  static constexpr std::uint32_t MESH = 8;
+
+  struct Draw {
+    std::uint64_t key;
+    std::uint32_t pass;
+    std::uint32_t shader;
+    std::uint32_t material;
+    std::uint32_t mesh;
+    // Caller data, like the entity drawn
+    std::uint32_t item;
+    // State to bind before the draw, set by sort
+    std::uint32_t changes;
+  };
+  // Shader, material and mesh binds of the last sorted queue
+  struct Stats {
+    std::size_t draws = 0;
+    std::size_t binds = 0;
+    // Binds saved compared to binding everything for every draw
+    std::size_t bindsAvoided = 0;
+  };
+
+  void clear() { draws.clear(); }
+  /**
+   * Queue a draw
+   * @param depth - not negative, like the squared distance from the camera
+   */
+  void push(std::uint32_t pass, std::uint32_t shader, std::uint32_t material,
+            std::uint32_t mesh, float depth, std::uint32_t item);
+  std::size_t size() const { return draws.size(); }
+  // Draws in key order, the span is valid until the next call
+  std::span<const Draw> sort();
+  const Stats &getStats() const { return stats; }
+
+private:
+  // Digits of the radix sort
+  static constexpr int RADIX_BITS = 8;
+  static constexpr std::size_t BUCKETS = 1 << RADIX_BITS;
+
+  // (key, index in draws) pairs, sorted instead of the larger draws
+  struct Entry {
+    std::uint64_t key;
+    std::uint32_t draw;
+  };
+  std::vector<Draw> draws;
+  std::vector<Entry> entries;
+  std::vector<Entry> scratch;
+  // Output of sort
+  std::vector<Draw> sorted;
+  Stats stats;
+
+  void radixSort();
+};
+
+#endif // RENDER_QUEUE_C
@@ -0,0 +1,109 @@
+#include "SceneGraph.h"
+
+#include <stdexcept>
+
+#include "../math/MatrixUtils.h"
+
+void SceneGraph::build(std::span<const std::uint32_t> parents) {
+  const std::size_t n = parents.size();
+  // Children lists in compressed form: children of node p are
+  // children[first[p], first[p + 1])
+  std::vector<std::uint32_t> first(n + 1, 0);
+  for (std::uint32_t p : parents) {
+    if (p == NO_PARENT)
+      continue;
+    if (p >= n) {
+      throw std::runtime_error("Scene graph parent out of range");
+    }
+    first[p + 1]++;
+  }
+  for (std::size_t i = 0; i < n; i++) {
+    first[i + 1] += first[i];
+  }
+  std::vector<std::uint32_t> children(first[n]);
+  std::vector<std::uint32_t> next(first.begin(), first.end() - 1);
+  for (std::uint32_t i = 0; i < n; i++) {
+    if (parents[i] != NO_PARENT) {
+      children[next[parents[i]]++] = i;
+    }
+  }
+
+  // Breadth first visit, roots first
+  order.clear();
+  for (std::uint32_t i = 0; i < n; i++) {
+    if (parents[i] == NO_PARENT) {
+      order.push_back(i);
+    }
+  }
+  for (std::size_t k = 0; k < order.size(); k++) {
+    std::uint32_t node = order[k];
+    for (std::uint32_t c = first[node]; c < first[node + 1]; c++) {
+      order.push_back(children[c]);
+    }
+  }
+  // Nodes in a cycle are never reached from a root
+  if (order.size() != n) {
+    throw std::runtime_error("Scene graph hierarchy contains a cycle");
+  }
+
+  position.resize(n);
+  for (std::uint32_t k = 0; k < n; k++) {
+    position[order[k]] = k;
+  }
+  parent.resize(n);
+  for (std::uint32_t k = 0; k < n; k++) {
+    std::uint32_t p = parents[order[k]];
+    parent[k] = p == NO_PARENT ? NO_PARENT : position[p];
+  }
+  local.resize(n);
+  world.resize(n);
+  for (Mat4f &m : local) {
+    m = mat::identity();
+  }
+  localPosition.resize(n);
+  worldPosition.resize(n);
+  for (Vec3d &v : localPosition) {
+    v = Vec3d();
+  }
+  localDirty.assign(n, 1);
+  worldDirty.assign(n, 1);
+}
+
+void SceneGraph::setLocalTransform(std::uint32_t node, const Mat4f &linear,
+                                   const Vec3d &translation) {
+  const std::uint32_t k = position[node];
+  local[k] = linear.clone();
+  localPosition[k] = translation.clone();
+  localDirty[k] = 1;
+}
+
+const Mat4f &SceneGraph::getWorldMatrix(std::uint32_t node) const {
+  return world[position[node]];
+}
+
+const Vec3d &SceneGraph::getWorldPosition(std::uint32_t node) const {
+  return worldPosition[position[node]];
+}
+
+std::span<const std::uint32_t> SceneGraph::propagate() {
+  updated.clear();
+  for (std::size_t k = 0; k < order.size(); k++) {
+    const std::uint32_t p = parent[k];
+    // Parents precede their children: worldDirty[p] is already final
+    const bool dirty = localDirty[k] || (p != NO_PARENT && worldDirty[p]);
+    worldDirty[k] = dirty;
+    if (!dirty)
+      continue;
+    if (p == NO_PARENT) {
+      world[k] = local[k].clone();
+      worldPosition[k] = localPosition[k].clone();
+    } else {
+      world[k] = world[p] * local[k];
+      worldPosition[k] = worldPosition[p] +
+                         mat::transformDirection(world[p], localPosition[k]);
+    }
+    localDirty[k] = 0;
+    updated.push_back(order[k]);
+  }
+  return updated;
+}
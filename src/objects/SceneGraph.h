@@ -0,0 +1,68 @@
+#ifndef SCENE_GRAPH_C
+#define SCENE_GRAPH_C
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "../math/AlignedAllocator.h"
+#include "../math/Matrix.h"
+
+/**
+ * Transform hierarchy. Nodes are stored breadth first in contiguous arrays,
+ * so parents always precede their children and the world matrices are
+ * propagated top-down with a single linear sweep. Only the subtrees whose
+ * local transforms changed are recomputed.
+ * Transforms are split in a float linear part (scale and rotation) and a
+ * double precision translation, so world positions stay accurate far
+ * away from the origin.
+ * Nodes are identified by the ids 0, ..., n - 1 given to build.
+ */
+class SceneGraph {
+public:
+  static constexpr std::uint32_t NO_PARENT =
+      std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * Rebuild the hierarchy, every world matrix becomes dirty.
+   * Throws if the parents contain a cycle or an invalid id.
+   * @param parents - parents[i] is the parent of node i, NO_PARENT for roots
+   */
+  void build(std::span<const std::uint32_t> parents);
+  std::size_t size() const { return order.size(); }
+  /**
+   * Transform of a node relative to its parent
+   * @param linear - scale and rotation, the translation is ignored
+   * @param translation - position in the parent frame
+   */
+  void setLocalTransform(std::uint32_t node, const Mat4f &linear,
+                         const Vec3d &translation);
+  // World scale and rotation
+  const Mat4f &getWorldMatrix(std::uint32_t node) const;
+  const Vec3d &getWorldPosition(std::uint32_t node) const;
+  /**
+   * Recompute the world transforms of the dirty subtrees.
+   * @return ids of the nodes whose world transform changed, parents first.
+   * The span is valid until the next call.
+   */
+  std::span<const std::uint32_t> propagate();
+
+private:
+  // Indexed by node id: position in the breadth first arrays
+  std::vector<std::uint32_t> position;
+  // Breadth first arrays
+  std::vector<std::uint32_t> order;
+  // Position of the parent or NO_PARENT
+  std::vector<std::uint32_t> parent;
+  AlignedVector<Mat4f, 16> local;
+  AlignedVector<Mat4f, 16> world;
+  std::vector<Vec3d> localPosition;
+  std::vector<Vec3d> worldPosition;
+  std::vector<std::uint8_t> localDirty;
+  std::vector<std::uint8_t> worldDirty;
+  // Output of propagate
+  std::vector<std::uint32_t> updated;
+};
+
+#endif // SCENE_GRAPH_C
@@ -0,0 +1,98 @@
+#include "TransparentQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+// Sort key of the distance. The bits of non negative floats are ordered
+// like their values, they are inverted to sort the farthest first
+static std::uint32_t distanceKey(std::uint64_t key) { return key >> 32; }
+
+void TransparentQueue::push(std::uint32_t node, float distance2) {
+  const std::uint32_t bits = ~std::bit_cast<std::uint32_t>(distance2);
+  keys.push_back(static_cast<std::uint64_t>(bits) << 32 | node);
+}
+
+void TransparentQueue::restorePreviousOrder() {
+  // The previous frame order, with holes for the nodes gone
+  scratch.assign(nodes.size(), NO_KEY);
+  std::size_t fresh = 0;
+  for (std::uint64_t key : keys) {
+    const std::uint32_t node = static_cast<std::uint32_t>(key);
+    const std::uint32_t slot =
+        node < previousSlot.size() ? previousSlot[node] : NO_SLOT;
+    if (slot != NO_SLOT && scratch[slot] == NO_KEY) {
+      scratch[slot] = key;
+    } else {
+      keys[fresh++] = key;
+    }
+  }
+  // New nodes after the old ones
+  std::move_backward(keys.begin(), keys.begin() + fresh, keys.end());
+  auto out = keys.begin();
+  for (std::uint64_t key : scratch) {
+    if (key != NO_KEY) {
+      *out++ = key;
+    }
+  }
+}
+
+bool TransparentQueue::insertionSort(std::size_t maxMoves) {
+  std::size_t moves = 0;
+  for (std::size_t i = 1; i < keys.size(); i++) {
+    const std::uint64_t key = keys[i];
+    std::size_t j = i;
+    for (; j > 0 && distanceKey(keys[j - 1]) > distanceKey(key); j--) {
+      keys[j] = keys[j - 1];
+    }
+    keys[j] = key;
+    moves += i - j;
+    if (moves > maxMoves)
+      return false;
+  }
+  return true;
+}
+
+void TransparentQueue::radixSort() {
+  scratch.resize(keys.size());
+  for (int shift = 32; shift < 64; shift += RADIX_BITS) {
+    std::array<std::size_t, BUCKETS> offsets{};
+    for (std::uint64_t key : keys) {
+      offsets[(key >> shift) & (BUCKETS - 1)]++;
+    }
+    // All the keys share this digit, nothing to move
+    if (std::ranges::find(offsets, keys.size()) != offsets.end())
+      continue;
+    std::size_t offset = 0;
+    for (std::size_t &bucket : offsets) {
+      const std::size_t count = bucket;
+      bucket = offset;
+      offset += count;
+    }
+    for (std::uint64_t key : keys) {
+      scratch[offsets[(key >> shift) & (BUCKETS - 1)]++] = key;
+    }
+    keys.swap(scratch);
+  }
+}
+
+std::span<const std::uint32_t> TransparentQueue::sort() {
+  restorePreviousOrder();
+  if (!insertionSort(MAX_MOVES_PER_KEY * keys.size())) {
+    radixSort();
+  }
+  // Forget the previous order
+  for (std::uint32_t node : nodes) {
+    previousSlot[node] = NO_SLOT;
+  }
+  nodes.clear();
+  for (std::uint64_t key : keys) {
+    const std::uint32_t node = static_cast<std::uint32_t>(key);
+    if (node >= previousSlot.size()) {
+      previousSlot.resize(node + 1, NO_SLOT);
+    }
+    previousSlot[node] = nodes.size();
+    nodes.push_back(node);
+  }
+  return nodes;
+}
@@ -0,0 +1,61 @@
+#ifndef TRANSPARENT_QUEUE_C
+#define TRANSPARENT_QUEUE_C
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+/**
+ * Back to front order of the transparent entities, rebuilt every frame.
+ * Each entity is a 64 bit key: its camera distance in the high 32 bits,
+ * its node in the low ones, so entities at the same distance are all kept.
+ * The keys are sorted by distance with a stable LSD radix sort.
+ * Between frames the order barely changes: the keys are first laid out in
+ * the order of the previous frame, so an unchanged order costs a linear
+ * check and a few swaps cost an insertion sort.
+ * The buffers are reused, after the first frames sorting doesn't allocate.
+ */
+class TransparentQueue {
+public:
+  // Start a new frame
+  void clear() { keys.clear(); }
+  /**
+   * Queue a node, at most once per frame
+   * @param distance2 - squared distance from the camera, not negative
+   */
+  void push(std::uint32_t node, float distance2);
+  std::size_t size() const { return keys.size(); }
+  /**
+   * Nodes from the farthest to the closest, nodes at the same distance in
+   * the order of the previous frame. The span is valid until the next call
+   */
+  std::span<const std::uint32_t> sort();
+
+private:
+  static constexpr std::uint32_t NO_SLOT =
+      std::numeric_limits<std::uint32_t>::max();
+  static constexpr std::uint64_t NO_KEY =
+      std::numeric_limits<std::uint64_t>::max();
+  // Digits of the radix sort, over the 32 distance bits
+  static constexpr int RADIX_BITS = 8;
+  static constexpr std::size_t BUCKETS = 1 << RADIX_BITS;
+  // The insertion sort gives up after this many moves per key
+  static constexpr std::size_t MAX_MOVES_PER_KEY = 4;
+
+  std::vector<std::uint64_t> keys;
+  std::vector<std::uint64_t> scratch;
+  // Output of sort
+  std::vector<std::uint32_t> nodes;
+  // Indexed by node: position in the last sorted order, NO_SLOT if absent
+  std::vector<std::uint32_t> previousSlot;
+
+  // Lay the keys out in the order of the previous frame, new nodes last
+  void restorePreviousOrder();
+  // False if the keys needed more than maxMoves moves, they are left
+  // partially sorted
+  bool insertionSort(std::size_t maxMoves);
+  void radixSort();
+};
+
+#endif // TRANSPARENT_QUEUE_C
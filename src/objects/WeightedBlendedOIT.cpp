@@ -0,0 +1,55 @@
+#include "WeightedBlendedOIT.h"
+
+static constexpr ColorFormat TARGET_FORMATS[] = {
+    // ACCUM, the weights exceed the range of 8 bits
+    {GL_RGBA16F, GL_RGBA, GL_FLOAT},
+    // WEIGHT
+    {GL_R16F, GL_RED, GL_FLOAT}};
+
+WeightedBlendedOIT::WeightedBlendedOIT(float width, float height)
+    : width{width}, height{height}, targets{width, height, TARGET_FORMATS},
+      screenQuad{Mesh::screenQuad()} {
+  compositeShader.use();
+  compositeShader.setTargets(0, 1);
+}
+
+void WeightedBlendedOIT::begin() {
+  static constexpr unsigned int ALL[] = {ACCUM, WEIGHT};
+  // Revealage starts at 1, nothing covers the opaque scene
+  static constexpr GLfloat ACCUM_CLEAR[] = {0.0f, 0.0f, 0.0f, 1.0f};
+  static constexpr GLfloat WEIGHT_CLEAR[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  GLState &state = GLState::get();
+  opaqueBuffer = state.getDrawFramebuffer();
+  targets.setDrawBuffers(ALL);
+  // Transparent surfaces behind the opaque ones are hidden
+  state.bindFramebuffer(GL_READ_FRAMEBUFFER, opaqueBuffer);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                    GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  targets.bind();
+  glClearBufferfv(GL_COLOR, ACCUM, ACCUM_CLEAR);
+  glClearBufferfv(GL_COLOR, WEIGHT, WEIGHT_CLEAR);
+
+  // Colors and weights add up, the revealage is multiplied by (1 - alpha)
+  state.enable(GL_BLEND);
+  state.blendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+  state.enable(GL_DEPTH_TEST);
+  state.depthMask(false);
+}
+
+void WeightedBlendedOIT::composite() {
+  GLState &state = GLState::get();
+  state.bindFramebuffer(GL_FRAMEBUFFER, opaqueBuffer);
+  state.activeTexture(0);
+  targets.bindColor(ACCUM);
+  state.activeTexture(1);
+  targets.bindColor(WEIGHT);
+  compositeShader.use();
+  state.disable(GL_DEPTH_TEST);
+  state.blendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+  screenQuad.render();
+
+  // Default state of the forward passes
+  state.enable(GL_DEPTH_TEST);
+  state.depthMask(true);
+  state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
@@ -0,0 +1,51 @@
+#ifndef WEIGHTED_BLENDED_OIT_C
+#define WEIGHTED_BLENDED_OIT_C
+
+#include <glad/glad.h>
+
+#include "../buffer/FrameBuffer.h"
+#include "../shaders/transparency/OitCompositeShader.h"
+#include "Model.h"
+
+/**
+ * Weighted blended order independent transparency (McGuire and Bavoil).
+ * Transparent fragments are drawn in any order: their colors are summed,
+ * weighted by alpha and depth, in an accumulation target while the product
+ * of their (1 - alpha), the revealage, is kept in its alpha channel. The
+ * composite pass blends the weighted average color over the opaque scene.
+ * GL 3.3 has no per target blending, so the sum of the weights goes in a
+ * second target with the same additive color blending.
+ * Intersecting and unsorted surfaces are handled, at the cost of an
+ * approximate result when many layers have a high alpha.
+ */
+class WeightedBlendedOIT {
+public:
+  enum Attachment : unsigned int {
+    // Sum of the weighted premultiplied colors, revealage in alpha
+    ACCUM = 0,
+    WEIGHT
+  };
+
+  WeightedBlendedOIT(float width, float height);
+  /**
+   * Bind the transparency targets, depth tested against the frame buffer
+   * bound now. It must have the size of the targets and a 24 bit depth
+   * with 8 bit stencil buffer, like FrameBuffer.
+   * The shaders must write the accumulation to output 0 and the weight to
+   * output 1, with the blending set here
+   */
+  void begin();
+  // Blend the transparent surfaces over the frame buffer bound by begin
+  void composite();
+
+private:
+  float width;
+  float height;
+  FrameBuffer targets;
+  OitCompositeShader compositeShader;
+  Mesh screenQuad;
+  // Frame buffer the transparent surfaces are composited on
+  GLuint opaqueBuffer = 0;
+};
+
+#endif // WEIGHTED_BLENDED_OIT_C
@@ -1,20 +1,48 @@
 #ifndef UNIFORM_C
 #define UNIFORM_C
 
+#include <algorithm>
 #include <cassert>
 #include <glad/glad.h>
+#include <optional>
+#include <span>
+#include <vector>
 
+#include "../buffer/GLState.h"
 #include "../math/Matrix.h"
+#include "../math/Std140.h"
 
-// This class represents a uniform field of a shader.
+// Writes of all the uniforms since the start, reset by assigning {}
+struct UniformStats {
+  std::size_t uploads = 0;
+  // Writes of the value the program already had, not sent to the driver
+  std::size_t skipped = 0;
+};
+
+inline UniformStats &getUniformStats() {
+  static UniformStats stats;
+  return stats;
+}
+
+// Copy of the last value of a uniform, arrays are copied out of their span
+template <typename T> struct UniformCache {
+  using type = T;
+};
+template <> struct UniformCache<std::span<const int>> {
+  using type = std::vector<int>;
+};
+
+// This class represents a uniform field of a shader. Arrays of int are set
+// from their first element with T = std::span<const int>.
+// The last value written is cached: the uniforms belong to the program, so
+// writing it again is skipped. Not copyable, matrices aren't
 template <typename T> class Uniform {
 private:
   GLint location{-1};
   GLuint programID;
   std::string name;
-  // TODO: add a comparison operator for vector/matrices of floats
-  //  and implement a cache system (not compatible with copy ctor)
-  // std::optional<T> cachedData{std::nullopt};
+  std::optional<typename UniformCache<T>::type> cachedData{std::nullopt};
+  bool isCached(const T &data) const;
   void setUniformInternal(const T &data) const;
   void assertProgramInUse() const;
 
@@ -39,24 +67,56 @@ template <typename T> void Uniform<T>::setUniformInternal(const T &data) const {
     glUniform1f(location, data);
   } else if constexpr (std::is_same_v<dT, Mat4f>) {
     glUniformMatrix4fv(location, 1, GL_FALSE, data.data().data());
+  } else if constexpr (std::is_same_v<dT, Mat3f>) {
+    glUniformMatrix3fv(location, 1, GL_FALSE, data.data().data());
   } else if constexpr (std::is_same_v<dT, Vec3f>) {
     glUniform3fv(location, 1, data.data().data());
+  } else if constexpr (std::is_same_v<dT, PaddedVec3f>) {
+    glUniform3fv(location, 1, data.data());
   } else if constexpr (std::is_same_v<dT, Vec4f>) {
     glUniform4fv(location, 1, data.data().data());
   } else if constexpr (std::is_same_v<dT, std::size_t>) {
     glUniform1i(location, data);
+  } else if constexpr (std::is_same_v<dT, std::span<const int>>) {
+    glUniform1iv(location, data.size(), data.data());
   } else {
     static_assert(false);
   }
 }
 
+template <typename T> bool Uniform<T>::isCached(const T &data) const {
+  if (!cachedData)
+    return false;
+  if constexpr (std::is_same_v<T, std::span<const int>>) {
+    return std::ranges::equal(*cachedData, data);
+  } else {
+    return *cachedData == data;
+  }
+}
+
 template <typename T> void Uniform<T>::setUniform(const T &data) {
+  UniformStats &stats = getUniformStats();
+  if (isCached(data)) {
+    stats.skipped++;
+    return;
+  }
   setUniformInternal(data);
+  stats.uploads++;
+  if constexpr (std::is_same_v<T, std::span<const int>>) {
+    // Reuses the storage of the previous value
+    if (cachedData) {
+      cachedData->assign(data.begin(), data.end());
+    } else {
+      cachedData.emplace(data.begin(), data.end());
+    }
+  } else if constexpr (requires { data.clone(); }) {
+    cachedData.emplace(data.clone());
+  } else {
+    cachedData.emplace(data);
+  }
 }
 
 template <typename T> void Uniform<T>::assertProgramInUse() const {
-  GLint activeProgramID = 0;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &activeProgramID);
-  assert(programID == activeProgramID);
+  assert(programID == GLState::get().getProgram());
 }
 #endif // UNIFORM_C
\ No newline at end of file
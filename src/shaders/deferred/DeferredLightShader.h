@@ -0,0 +1,88 @@
+#ifndef DEFERRED_LIGHT_SHADER_C
+#define DEFERRED_LIGHT_SHADER_C
+
+#include <limits>
+#include <string>
+
+#include "../../objects/Light.h"
+#include "../Shader.h"
+#include "../Uniform.h"
+
+// Binding class with the Light struct of deferred_light.fs
+class UniformLight {
+public:
+  Uniform<Vec4f> lightVector;
+  Uniform<Vec3f> ambient;
+  Uniform<Vec3f> diffuse;
+  Uniform<Vec3f> specular;
+  Uniform<Vec3f> attenuation;
+  UniformLight(GLuint ID, const std::string &lightName)
+      : lightVector{ID, lightName + std::string(".lightVector")},
+        ambient{ID, lightName + std::string(".ambient")},
+        diffuse{ID, lightName + std::string(".diffuse")},
+        specular{ID, lightName + std::string(".specular")},
+        attenuation{ID, lightName + std::string(".attenuation")} {};
+};
+
+// Binding class with the lighting pass shader files
+class DeferredLightShader : public ShaderProgram {
+private:
+  UniformLight light{rawProgram->getID(), "light"};
+  Uniform<float> lightRadius{rawProgram->getID(), "lightRadius"};
+  Uniform<Mat4f> pvmMatrix{rawProgram->getID(), "pvmMatrix"};
+  Uniform<int> fullScreen{rawProgram->getID(), "fullScreen"};
+  Uniform<Mat4f> inversePV{rawProgram->getID(), "inversePV"};
+  Uniform<int> gAlbedoSpecular{rawProgram->getID(), "gAlbedoSpecular"};
+  Uniform<int> gNormal{rawProgram->getID(), "gNormal"};
+  Uniform<int> gDistance{rawProgram->getID(), "gDistance"};
+
+  void setLight(const Light &source, const Vec4f &lightVector) {
+    light.ambient.setUniform(source.ambientIntensity);
+    light.diffuse.setUniform(source.diffuseIntensity);
+    light.specular.setUniform(source.specularIntensity);
+    light.lightVector.setUniform(lightVector);
+  }
+
+public:
+  DeferredLightShader()
+      : ShaderProgram("src/shaders/deferred/deferred_light.vs",
+                      "src/shaders/deferred/deferred_light.fs") {};
+
+  /**
+   * @param position - camera relative position of the light
+   * @param pvm - transform of the light volume
+   */
+  void setPointLight(const PointLight &source, const Vec3f &position,
+                     float radius, const Mat4f &pvm) {
+    setLight(source, Vec4f{position(0), position(1), position(2), 1.0f});
+    light.attenuation.setUniform(source.attenuationCoefficients);
+    lightRadius.setUniform(radius);
+    pvmMatrix.setUniform(pvm);
+    fullScreen.setUniform(0);
+  }
+  // Lights the whole screen
+  void setDirectionalLight(const DirectionalLight &source) {
+    setLight(source, source.getLightVector());
+    fullScreen.setUniform(1);
+  }
+  // Point light not bounded by a volume, lights the whole screen
+  void setUnboundedLight(const PointLight &source, const Vec3f &position) {
+    setLight(source, Vec4f{position(0), position(1), position(2), 1.0f});
+    light.attenuation.setUniform(source.attenuationCoefficients);
+    lightRadius.setUniform(std::numeric_limits<float>::infinity());
+    fullScreen.setUniform(1);
+  }
+  void setInversePV(const Mat4f &m) { inversePV.setUniform(m); }
+  // Texture units of the G-buffer attachments
+  void setGBuffer(int albedoSpecular, int normal, int distance) {
+    gAlbedoSpecular.setUniform(albedoSpecular);
+    gNormal.setUniform(normal);
+    gDistance.setUniform(distance);
+  }
+  bool setTexture(TextureType textureType, int textureNumber,
+                  int textureUnit) override {
+    return false;
+  };
+};
+
+#endif // DEFERRED_LIGHT_SHADER_C
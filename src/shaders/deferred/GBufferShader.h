@@ -0,0 +1,46 @@
+#ifndef G_BUFFER_SHADER_C
+#define G_BUFFER_SHADER_C
+
+#include "../Shader.h"
+#include "../Uniform.h"
+
+// Binding class with the geometry pass shader files
+class GBufferShader : public ShaderProgram {
+private:
+  Uniform<Mat4f> cameraPV{rawProgram->getID(), "pvMatrix"};
+  Uniform<Mat4f> modelMatrix{rawProgram->getID(), "mMatrix"};
+  Uniform<Mat3f> normalMatrix{rawProgram->getID(), "nMatrix"};
+  Uniform<int> instanced{rawProgram->getID(), "instanced"};
+  Uniform<int> materialSpecular{rawProgram->getID(),
+                                "material.texture_specular1"};
+  Uniform<int> materialDiffuse{rawProgram->getID(),
+                               "material.texture_diffuse1"};
+
+public:
+  GBufferShader()
+      : ShaderProgram("src/shaders/phong_light_model/phong_light.vs",
+                      "src/shaders/deferred/gbuffer.fs") {};
+
+  // Camera relative projection * view matrix
+  void setPvMatrix(const Mat4f &m) { cameraPV.setUniform(m); }
+  void setModelMatrix(const Mat4f &m) { modelMatrix.setUniform(m); }
+  void setNormalMatrix(const Mat3f &m) { normalMatrix.setUniform(m); }
+  // Model and normal matrices of the instances instead of the uniforms
+  void setInstanced(bool enabled) { instanced.setUniform(enabled); }
+  bool setTexture(TextureType textureType, int textureNumber,
+                  int textureUnit) override {
+    if (textureNumber > 1) {
+      return false;
+    }
+    if (textureType == TextureType::SPECULAR) {
+      materialSpecular.setUniform(textureUnit);
+    } else if (textureType == TextureType::DIFFUSE) {
+      materialDiffuse.setUniform(textureUnit);
+    } else {
+      return false;
+    }
+    return true;
+  };
+};
+
+#endif // G_BUFFER_SHADER_C
@@ -0,0 +1,82 @@
+#version 330 core
+
+// Lighting pass of the deferred pipeline: one light applied to the G-buffer
+// texels covered by its volume, added to the lit color. Same light model
+// as phong_light.fs
+
+struct Light {
+    // For point light the lightVector is the position of the light source. Fourth component is 1.0
+    // For directional lights the lightVector is the direction of the light rays. Fourth component is 0.0
+    vec4 lightVector;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 attenuation;
+};
+
+out vec4 FragColor;
+
+uniform Light light;
+// Point lights have no effect farther than lightRadius
+uniform float lightRadius;
+// Inverse of the camera relative projection * view matrix
+uniform mat4 inversePV;
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDistance;
+
+uniform bool blinnCorrection = true;
+
+vec3 CalcLightInternal(vec3 normal, vec3 diffuseTexel, vec3 specularTexel, vec3 viewDir, vec3 lightDir){
+    vec3 ambient = light.ambient * diffuseTexel;
+
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffusion = light.diffuse * diff * diffuseTexel;
+
+    float spec = 0;
+    if(blinnCorrection){
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        spec = pow(max(dot(halfwayDir, normal), 0.0), 32.0);
+    } else {
+        vec3 reflectDir = reflect(-lightDir, normal);
+        spec = pow(max(dot(reflectDir, viewDir), 0.0), 32.0);
+    }
+    vec3 specular = light.specular * specularTexel * spec;
+
+    return (ambient + diffusion + specular);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float dist = texelFetch(gDistance, texel, 0).r;
+    // Background
+    if (dist == 0.0)
+        discard;
+    // The eye is in the origin, the fragment is along the ray through the pixel
+    vec2 ndc = gl_FragCoord.xy/vec2(textureSize(gDistance, 0))*2.0 - 1.0;
+    vec4 farPoint = inversePV*vec4(ndc, 1.0, 1.0);
+    vec3 fragPos = normalize(farPoint.xyz/farPoint.w)*dist;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, texel, 0);
+    vec3 diffuseTexel = albedoSpecular.rgb;
+    vec3 specularTexel = vec3(albedoSpecular.a);
+    vec3 normal = texelFetch(gNormal, texel, 0).xyz;
+    vec3 viewDir = normalize(-fragPos);
+
+    vec3 color;
+    if (light.lightVector.w > 0.99) {
+        vec3 lightPos = light.lightVector.xyz;
+        float d = length(fragPos - lightPos);
+        // The volume is larger than the light sphere
+        if (d >= lightRadius)
+            discard;
+        vec3 partial = CalcLightInternal(normal, diffuseTexel, specularTexel, viewDir, normalize(lightPos - fragPos));
+        color = partial/dot(light.attenuation, vec3(1, d, d*d));
+    } else {
+        color = CalcLightInternal(normal, diffuseTexel, specularTexel, viewDir, normalize(-light.lightVector.xyz));
+    }
+    // Added to the lit color, its alpha stays 1
+    FragColor = vec4(color, 0.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Light volume transform, unused by full screen passes
+uniform mat4 pvmMatrix;
+// Draw a quad already in normalized device coordinates
+uniform bool fullScreen = false;
+
+void main()
+{
+    gl_Position = fullScreen ? vec4(aPos.xy, 0.0, 1.0) : pvmMatrix*vec4(aPos, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+
+// Geometry pass of the deferred pipeline: material data of the closest
+// surface, lit later by deferred_light.fs. Vertex shader phong_light.vs
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec3 normal;
+in vec3 fragPos;
+in vec2 TexCoord;
+
+// Draw buffers of the G-buffer, see DeferredRenderer
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalOut;
+layout (location = 2) out float distanceOut;
+
+uniform Material material;
+
+void main()
+{
+    albedoSpecular.rgb = texture(material.texture_diffuse1, TexCoord).rgb;
+    // Single channel specular intensity
+    albedoSpecular.a = texture(material.texture_specular1, TexCoord).r;
+    normalOut = vec4(normalize(normal), 0.0);
+    // fragPos is camera relative, 0 is left to the background
+    distanceOut = length(fragPos);
+}
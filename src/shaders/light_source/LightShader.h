@@ -9,6 +9,8 @@ class LightShader : public ShaderProgram {
 private:
   Uniform<Vec3f> lightColor{rawProgram->getID(), "lightColor"};
   Uniform<Mat4f> pvmMatrix{rawProgram->getID(), "pvmMatrix"};
+  Uniform<Mat4f> pvMatrix{rawProgram->getID(), "pvMatrix"};
+  Uniform<int> instanced{rawProgram->getID(), "instanced"};
 
 public:
   LightShader()
@@ -17,6 +19,10 @@ public:
 
   void setPvmMatrix(const Mat4f &mat) { pvmMatrix.setUniform(mat); }
   void setLightColor(const Vec3f &color) { lightColor.setUniform(color); }
+  // Projection * view matrix of the instances
+  void setPvMatrix(const Mat4f &mat) { pvMatrix.setUniform(mat); }
+  // Model matrix and color of the instances instead of the uniforms
+  void setInstanced(bool enabled) { instanced.setUniform(enabled); }
   bool setTexture(TextureType textureType, int textureNumber,
                   int textureUnit) override {
     return false;
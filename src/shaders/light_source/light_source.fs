@@ -1,10 +1,13 @@
 #version 330 core
 
+flat in vec3 instanceColor;
+
 out vec4 FragColor;
 
 uniform vec3 lightColor = vec3(1.0, 1.0, 1.0);
+uniform bool instanced = false;
 
 void main()
 {
-    FragColor = vec4(lightColor, 1.0);
+    FragColor = vec4(instanced ? instanceColor : lightColor, 1.0);
 }
\ No newline at end of file
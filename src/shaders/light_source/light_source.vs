@@ -1,9 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// Per instance attributes, see InstanceBuffer
+layout (location = 3) in mat4 aModelMatrix;
+layout (location = 10) in vec3 aColor;
 
 uniform mat4 pvmMatrix;
+// Projection * view matrix of the instances
+uniform mat4 pvMatrix;
+// Take the model matrix and color from the instance attributes
+uniform bool instanced = false;
+
+flat out vec3 instanceColor;
 
 void main()
 {
-    gl_Position = pvmMatrix*vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    vec4 position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    gl_Position = instanced ? pvMatrix*aModelMatrix*position : pvmMatrix*position;
+    instanceColor = aColor;
 }
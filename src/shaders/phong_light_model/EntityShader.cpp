@@ -1,40 +1,77 @@
 #include "EntityShader.h"
 
-#include <cassert>
+#include <algorithm>
 
-UniformLight &EntityShader::setLight(const Light &light, int lightNumber) {
-  if (lightNumber + 1 > uniformLights.size()) {
-    assert(lightNumber == uniformLights.size());
-    uniformLights.push_back(UniformLight{
-        rawProgram->getID(), std::format("lights[{}]", lightNumber)});
-  }
-  auto &uLight = uniformLights.at(lightNumber);
-  uLight.ambient.setUniform(light.ambientIntensity);
-  uLight.diffuse.setUniform(light.diffuseIntensity);
-  uLight.specular.setUniform(light.specularIntensity);
-  uLight.lightVector.setUniform(light.getLightVector());
-  return uLight;
+EntityShader::EntityShader()
+    : ShaderProgram("src/shaders/phong_light_model/phong_light.vs",
+                    "src/shaders/phong_light_model/phong_light.fs") {
+  glUniformBlockBinding(
+      rawProgram->getID(),
+      glGetUniformBlockIndex(rawProgram->getID(), "LightBlock"),
+      LIGHT_BLOCK_BINDING);
+  use();
+  // Samplers of different types can't share a texture unit, even when
+  // clustered lights are disabled
+  clusterLightData.setUniform(CLUSTER_TEXTURE_UNIT);
+  clusterRanges.setUniform(CLUSTER_TEXTURE_UNIT + 1);
+  clusterLightIndices.setUniform(CLUSTER_TEXTURE_UNIT + 2);
+}
+
+LightData LightData::point(const PointLight &light, const Vec3f &position) {
+  return LightData{Vec4f{position(0), position(1), position(2), 1.0f},
+                   light.ambientIntensity, light.diffuseIntensity,
+                   light.specularIntensity, light.attenuationCoefficients};
 }
 
-void EntityShader::setPointLight(const PointLight &light, int lightNumber) {
-  auto &uLight = setLight(light, lightNumber);
-  uLight.attenuation.setUniform(light.attenuationCoefficients);
+LightData LightData::directional(const DirectionalLight &light) {
+  return LightData{light.getLightVector(), light.ambientIntensity,
+                   light.diffuseIntensity, light.specularIntensity,
+                   PaddedVec3f{}};
 }
 
-void EntityShader::setDirectionalLight(const DirectionalLight &light,
-                                       int lightNumber) {
-  setLight(light, lightNumber);
+void EntityShader::setLights(std::span<const LightData> lights) {
+  lightBlock.upload(lights);
+}
+
+void EntityShader::setLightIndices(std::span<const int> indices) {
+  indices = indices.first(std::min(indices.size(), MAX_ENTITY_LIGHTS));
+  lightIndices.setUniform(indices);
+  nLights.setUniform(static_cast<int>(indices.size()));
 }
 
 void EntityShader::setCamera(const Camera &camera) {
   cameraPV.setUniform(camera.getProjectionMatrix() * camera.getViewMatrix());
-  cameraPos.setUniform(camera.getCameraPos());
+  // Camera relative rendering: the eye is in the origin
+  cameraPos.setUniform(Vec3f{});
+}
+
+void EntityShader::setClusteredLights(const LightClusters &clusters,
+                                      std::span<const Vec4f> lightData) {
+  lightDataBuffer.upload(lightData);
+  clusterRangesBuffer.upload(clusters.getClusterRanges());
+  lightIndicesBuffer.upload(clusters.getLightIndices());
+  lightDataBuffer.bind(CLUSTER_TEXTURE_UNIT);
+  clusterRangesBuffer.bind(CLUSTER_TEXTURE_UNIT + 1);
+  lightIndicesBuffer.bind(CLUSTER_TEXTURE_UNIT + 2);
+  clusterNear.setUniform(clusters.getNear());
+  clusterSliceScale.setUniform(clusters.getSliceScale());
+  clusteredLights.setUniform(1);
+}
+
+void EntityShader::disableClusteredLights() { clusteredLights.setUniform(0); }
+
+void EntityShader::setWeightedBlended(bool enabled) {
+  weightedBlended.setUniform(enabled);
 }
 
-void EntityShader::setNumberOfLights(int n) { nLights.setUniform(n); }
+void EntityShader::setInstanced(bool enabled) { instanced.setUniform(enabled); }
 
 void EntityShader::setModelMatrix(const Mat4f &m) { modelMatrix.setUniform(m); }
 
+void EntityShader::setNormalMatrix(const Mat3f &m) {
+  normalMatrix.setUniform(m);
+}
+
 bool EntityShader::setTexture(TextureType textureType, int textureNumber,
                               int textureUnit) {
   if (textureNumber > 1) {
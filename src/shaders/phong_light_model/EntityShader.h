@@ -1,52 +1,101 @@
 #ifndef ENTITY_SHADER_C
 #define ENTITY_SHADER_C
 
+#include <cstddef>
+#include <span>
 #include <vector>
 
 #include "../../Camera.h"
+#include "../../buffer/BufferTexture.h"
+#include "../../buffer/UniformBuffer.h"
 #include "../../objects/Light.h"
+#include "../../objects/LightClusters.h"
 #include "../Uniform.h"
 #include "../Shader.h"
 
-// Binding class with phong_light shader files
-class UniformLight {
-public:
-  Uniform<Vec4f> lightVector;
-  Uniform<Vec3f> ambient;
-  Uniform<Vec3f> diffuse;
-  Uniform<Vec3f> specular;
-  Uniform<Vec3f> attenuation;
-  UniformLight(GLuint ID, const std::string &lightName)
-      : lightVector{ID, lightName + std::string(".lightVector")},
-        ambient{ID, lightName + std::string(".ambient")},
-        diffuse{ID, lightName + std::string(".diffuse")},
-        specular{ID, lightName + std::string(".specular")},
-        attenuation{ID, lightName + std::string(".attenuation")} {};
+// Element of the LightBlock array of phong_light.fs, std140 layout
+struct LightData {
+  // Camera relative position with w = 1 or direction with w = 0
+  Vec4f lightVector;
+  PaddedVec3f ambient;
+  PaddedVec3f diffuse;
+  PaddedVec3f specular;
+  PaddedVec3f attenuation;
+
+  // position: camera relative position of the light
+  static LightData point(const PointLight &light, const Vec3f &position);
+  static LightData directional(const DirectionalLight &light);
 };
 
+template <> constexpr bool std140Struct<LightData> = true;
+static_assert(sizeof(LightData) == 80 && offsetof(LightData, ambient) == 16);
+
 class EntityShader : public ShaderProgram {
+public:
+  // Must match N_MAX_LIGHTS and N_MAX_ENTITY_LIGHTS of phong_light.fs
+  static constexpr std::size_t MAX_LIGHTS = 200;
+  static constexpr std::size_t MAX_ENTITY_LIGHTS = 32;
+
 private:
-  std::vector<UniformLight> uniformLights;
+  // Texture units of the cluster buffers, after the ones of the materials
+  static constexpr int CLUSTER_TEXTURE_UNIT = 13;
+  static constexpr GLuint LIGHT_BLOCK_BINDING = 0;
+
+  UniformBuffer lightBlock{MAX_LIGHTS * sizeof(LightData),
+                           LIGHT_BLOCK_BINDING};
   Uniform<Mat4f> cameraPV{rawProgram->getID(), "pvMatrix"};
   Uniform<Vec3f> cameraPos{rawProgram->getID(), "eyePos"};
   Uniform<Mat4f> modelMatrix{rawProgram->getID(), "mMatrix"};
+  Uniform<Mat3f> normalMatrix{rawProgram->getID(), "nMatrix"};
   Uniform<int> nLights{rawProgram->getID(), "nLights"};
+  Uniform<std::span<const int>> lightIndices{rawProgram->getID(),
+                                             "lightIndices"};
   Uniform<int> materialSpecular{rawProgram->getID(),
                                 "material.texture_specular1"};
   Uniform<int> materialDiffuse{rawProgram->getID(),
                                "material.texture_diffuse1"};
-  UniformLight &setLight(const Light &light, int lightNumber);
+  Uniform<int> clusteredLights{rawProgram->getID(), "clusteredLights"};
+  Uniform<int> clusterLightData{rawProgram->getID(), "clusterLightData"};
+  Uniform<int> clusterRanges{rawProgram->getID(), "clusterRanges"};
+  Uniform<int> clusterLightIndices{rawProgram->getID(),
+                                   "clusterLightIndices"};
+  Uniform<float> clusterNear{rawProgram->getID(), "clusterNear"};
+  Uniform<float> clusterSliceScale{rawProgram->getID(), "clusterSliceScale"};
+  Uniform<int> weightedBlended{rawProgram->getID(), "weightedBlended"};
+  Uniform<int> instanced{rawProgram->getID(), "instanced"};
+  BufferTexture lightDataBuffer{GL_RGBA32F};
+  BufferTexture clusterRangesBuffer{GL_RG32UI};
+  BufferTexture lightIndicesBuffer{GL_R32UI};
 
 public:
-  void setPointLight(const PointLight &light, int lightNumber);
-  void setDirectionalLight(const DirectionalLight &light, int lightNumber);
+  /**
+   * Write the lights of the frame in the light block, once for all the
+   * entities. At most MAX_LIGHTS
+   */
+  void setLights(std::span<const LightData> lights);
+  /**
+   * Lights of the next entities, indices in the light block. Only the first
+   * MAX_ENTITY_LIGHTS are used
+   */
+  void setLightIndices(std::span<const int> indices);
   void setCamera(const Camera &camera);
   void setModelMatrix(const Mat4f &m);
-  void setNumberOfLights(int n);
-  EntityShader()
-      : ShaderProgram("src/shaders/phong_light_model/phong_light.vs",
-                      "src/shaders/phong_light_model/phong_light.fs",
-                      "src/shaders/phong_light_model/phong_light.gs") {};
+  void setNormalMatrix(const Mat3f &m);
+  /**
+   * Shade the point lights by cluster, added to the lights of
+   * setLightIndices
+   * @param lightData - 4 texels per light: (camera relative position,
+   * radius), (ambient, attenuation(0)), (diffuse, attenuation(1)),
+   * (specular, attenuation(2))
+   */
+  void setClusteredLights(const LightClusters &clusters,
+                          std::span<const Vec4f> lightData);
+  void disableClusteredLights();
+  // Write the outputs of WeightedBlendedOIT instead of the color
+  void setWeightedBlended(bool enabled);
+  // Model and normal matrices of the instances instead of the uniforms
+  void setInstanced(bool enabled);
+  EntityShader();
 
   bool setTexture(TextureType textureType, int textureNumber,
                   int textureUnit) override;
@@ -20,16 +20,45 @@ struct Light {
 in vec3 normal;
 in vec3 fragPos;
 in vec2 TexCoord;
+in vec4 clipPos;
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// Sum of the weights of weighted blended transparency, see
+// WeightedBlendedOIT. Not drawn in the other passes
+layout (location = 1) out vec4 oitWeight;
 
 uniform vec3 eyePos;
 uniform Material material;
-#define N_MAX_LIGHTS 100
-uniform Light lights[N_MAX_LIGHTS];
+// Lights of the frame, written once for all the entities. std140 layout,
+// must match LightData and EntityShader::MAX_LIGHTS
+#define N_MAX_LIGHTS 200
+layout (std140) uniform LightBlock {
+    Light lights[N_MAX_LIGHTS];
+};
+// Indices in lights of the lights of the entity
+#define N_MAX_ENTITY_LIGHTS 32
+uniform int lightIndices[N_MAX_ENTITY_LIGHTS];
 uniform int nLights = 0;
 
+// Clustered point lights, see LightClusters. When enabled lights[] only
+// holds the directional lights
+// Must match LightClusters::TILES_X, TILES_Y and SLICES
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+uniform bool clusteredLights = false;
+// 4 texels per light: (position, radius), (ambient, attenuation.x),
+// (diffuse, attenuation.y), (specular, attenuation.z)
+uniform samplerBuffer clusterLightData;
+// (offset, count) in clusterLightIndices of the lights of each cluster
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLightIndices;
+uniform float clusterNear;
+uniform float clusterSliceScale;
+
 uniform bool blinnCorrection = true;
+// Write the weighted color and weight instead of the color
+uniform bool weightedBlended = false;
 
 vec3 CalcLightInternal(Light light, vec3 normal, vec3 eyePos, vec3 diffuseTexel, vec3 specularTexel, vec3 viewDir, vec3 lightDir){
     vec3 ambient = light.ambient * diffuseTexel;
@@ -67,8 +96,36 @@ vec3 CalcDirLightColor(Light light, vec3 normal, vec3 eyePos, vec3 diffuseTexel,
     return CalcLightInternal(light, normal, eyePos, diffuseTexel, specularTexel, viewDir, lightDir);
 }
 
+Light FetchClusterLight(int index, out float radius){
+    vec4 position = texelFetch(clusterLightData, 4*index);
+    vec4 ambient = texelFetch(clusterLightData, 4*index + 1);
+    vec4 diffuse = texelFetch(clusterLightData, 4*index + 2);
+    vec4 specular = texelFetch(clusterLightData, 4*index + 3);
+    radius = position.w;
+    return Light(vec4(position.xyz, 1.0), ambient.xyz, diffuse.xyz, specular.xyz,
+                 vec3(ambient.w, diffuse.w, specular.w));
+}
+
+// Closer and more opaque fragments weigh more in the weighted average,
+// weight function of McGuire and Bavoil with non linear depth
+float OitWeight(float alpha){
+    float depth = 1.0 - gl_FragCoord.z*0.9;
+    return clamp(pow(min(1.0, alpha*10.0) + 0.01, 3.0)*1e8*depth*depth*depth, 1e-2, 3e3);
+}
+
+int FindCluster(){
+    // clipPos.w is the view space depth
+    vec2 ndc = clipPos.xy/clipPos.w;
+    ivec2 tile = clamp(ivec2(floor((ndc*0.5 + 0.5)*vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y))),
+                       ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(floor(log(clipPos.w/clusterNear)*clusterSliceScale)), 0, CLUSTER_SLICES - 1);
+    return tile.x + CLUSTER_TILES_X*(tile.y + CLUSTER_TILES_Y*slice);
+}
+
 void main()
 {
+    // Interpolated normals are not unitary anymore
+    vec3 unitNormal = normalize(normal);
     vec4 diffuseVec = vec4(texture(material.texture_diffuse1, TexCoord));
     vec3 specularTexel = vec3(texture(material.texture_specular1, TexCoord));
     vec3 diffuseTexel = diffuseVec.xyz;
@@ -77,11 +134,29 @@ void main()
 
     vec3 color = vec3(0.0);
     for (int i = 0; i < nLights; i++){
-        if(lights[i].lightVector.w > 0.99) {
-            color += CalcPointLightColor(lights[i], normal, fragPos, eyePos, diffuseTexel, specularTexel, viewDir);
+        Light light = lights[lightIndices[i]];
+        if(light.lightVector.w > 0.99) {
+            color += CalcPointLightColor(light, unitNormal, fragPos, eyePos, diffuseTexel, specularTexel, viewDir);
         } else {
-            color += CalcDirLightColor(lights[i], normal, eyePos, diffuseTexel, specularTexel, viewDir);
+            color += CalcDirLightColor(light, unitNormal, eyePos, diffuseTexel, specularTexel, viewDir);
+        }
+    }
+    if (clusteredLights) {
+        uvec2 range = texelFetch(clusterRanges, FindCluster()).xy;
+        for (uint i = range.x; i < range.x + range.y; i++){
+            float radius;
+            Light light = FetchClusterLight(int(texelFetch(clusterLightIndices, int(i)).x), radius);
+            // Parts of the cluster can be out of reach of the light
+            if (length(light.lightVector.xyz - fragPos) < radius) {
+                color += CalcPointLightColor(light, unitNormal, fragPos, eyePos, diffuseTexel, specularTexel, viewDir);
+            }
         }
     }
-    FragColor = vec4(color, alpha);
+    if (weightedBlended) {
+        float weight = OitWeight(alpha);
+        FragColor = vec4(color*alpha*weight, alpha);
+        oitWeight = vec4(alpha*weight);
+    } else {
+        FragColor = vec4(color, alpha);
+    }
 }
\ No newline at end of file
@@ -1,15 +1,31 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+// Per instance attributes, see InstanceBuffer
+layout (location = 3) in mat4 aModelMatrix;
+layout (location = 7) in mat3 aNormalMatrix;
 
+uniform mat4 pvMatrix;
 uniform mat4 mMatrix;
+// Inverse transpose of mMatrix, computed on the CPU
+uniform mat3 nMatrix;
+// Take the model and normal matrices from the instance attributes
+uniform bool instanced = false;
 
-out VS_OUT {
-    vec2 TexCoord;
-} vs_out;
+out vec3 normal;
+out vec3 fragPos;
+out vec2 TexCoord;
+// Used to find the light cluster of the fragments
+out vec4 clipPos;
 
 void main()
 {
-    gl_Position = mMatrix*vec4(aPos.x, aPos.y, aPos.z, 1.0);
-    vs_out.TexCoord = aTexCoord;
+    mat4 model = instanced ? aModelMatrix : mMatrix;
+    vec4 worldPos = model*vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    fragPos = worldPos.xyz;
+    normal = (instanced ? aNormalMatrix : nMatrix)*aNormal;
+    TexCoord = aTexCoord;
+    gl_Position = pvMatrix*worldPos;
+    clipPos = gl_Position;
 }
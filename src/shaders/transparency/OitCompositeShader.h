@@ -0,0 +1,29 @@
+#ifndef OIT_COMPOSITE_SHADER_C
+#define OIT_COMPOSITE_SHADER_C
+
+#include "../Shader.h"
+#include "../Uniform.h"
+
+// Binding class with oit_composite shader files
+class OitCompositeShader : public ShaderProgram {
+public:
+  OitCompositeShader()
+      : ShaderProgram("src/shaders/transparency/oit_composite.vs",
+                      "src/shaders/transparency/oit_composite.fs") {};
+
+  bool setTexture(TextureType textureType, int textureNumber,
+                  int textureUnit) override {
+    return false;
+  };
+  // Texture units of the accumulation and weight targets
+  void setTargets(int accumUnit, int weightUnit) {
+    accumTexture.setUniform(accumUnit);
+    weightTexture.setUniform(weightUnit);
+  }
+
+private:
+  Uniform<int> accumTexture{rawProgram->getID(), "accumTexture"};
+  Uniform<int> weightTexture{rawProgram->getID(), "weightTexture"};
+};
+
+#endif // OIT_COMPOSITE_SHADER_C
@@ -0,0 +1,27 @@
+#version 330 core
+
+// Composite pass of weighted blended transparency: the weighted average of
+// the transparent colors, blended over the opaque ones by the revealage
+
+out vec4 FragColor;
+
+// rgb: sum of the weighted premultiplied colors, a: revealage, the product
+// of (1 - alpha) of all the transparent fragments
+uniform sampler2D accumTexture;
+// Sum of the weighted alphas
+uniform sampler2D weightTexture;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumTexture, texel, 0);
+    float revealage = accum.a;
+    // Nothing transparent in this pixel
+    if (revealage >= 1.0)
+        discard;
+    float weight = texelFetch(weightTexture, texel, 0).r;
+    vec3 average = accum.rgb/max(weight, 1e-5);
+    // Blended with (1 - alpha, alpha): the opaque color is covered by the
+    // transparent surfaces except for the revealage
+    FragColor = vec4(average, revealage);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Full screen quad, already in normalized device coordinates
+void main()
+{
+    gl_Position = vec4(aPos.xy, 0.0, 1.0);
+}